@@ -0,0 +1,255 @@
+#pragma once
+
+#include "asset-cache.h"
+#include "hierarchy.h"
+#include "render-queue.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace UI
+{
+
+// The frames of one animation, shared by every sprite playing it. Frames are
+// sub-rects of a single texture (a sheet or atlas page) with their texture
+// coordinates worked out up front.
+struct AnimationTable
+{
+  struct Frame
+  {
+    float left, top, right, bottom;
+    sf::Vector2f size;
+  };
+
+  const sf::Texture* texture = nullptr;
+  std::vector< Frame > frames;
+  // Seconds each frame is shown
+  float frame_time = 0.1f;
+  bool loop = true;
+
+  AnimationTable(const sf::Texture* texture, const std::vector< sf::IntRect >& rects, float frame_time, bool loop = true)
+  : texture(texture), frame_time(frame_time), loop(loop)
+  {
+    frames.reserve(rects.size());
+    for(const auto& rect : rects)
+      frames.push_back({
+        (float)rect.left, (float)rect.top,
+        (float)(rect.left + rect.width), (float)(rect.top + rect.height),
+        sf::Vector2f(rect.width, rect.height)
+      });
+  }
+
+  // `count` frames of `frame_size` read left to right, top to bottom from a
+  // sprite sheet, starting at frame `first`
+  AnimationTable(TextureCache& cache, const std::string& path, sf::Vector2u frame_size, unsigned first, unsigned count, float frame_time, bool loop = true)
+  : AnimationTable(cache.get(path), {}, frame_time, loop)
+  {
+    if(!texture || frame_size.x == 0 || frame_size.y == 0)
+      return;
+    const unsigned columns = texture->getSize().x / frame_size.x;
+    if(columns == 0)
+      return;
+
+    frames.reserve(count);
+    for(unsigned i = first; i < first + count; ++i)
+    {
+      const float left = (i % columns) * frame_size.x, top = (i / columns) * frame_size.y;
+      frames.push_back({ left, top, left + frame_size.x, top + frame_size.y, sf::Vector2f(frame_size) });
+    }
+  }
+};
+
+// Named animation tables. Tables are never moved, so components may keep
+// pointers to them.
+struct AnimationLibrary
+{
+  std::unordered_map< std::string, std::unique_ptr< AnimationTable > > tables;
+
+  // Redefining a name updates its table in place
+  const AnimationTable* define(const std::string& name, AnimationTable table)
+  {
+    auto& entry = tables[name];
+    if(entry)
+      *entry = std::move(table);
+    else
+      entry = std::make_unique< AnimationTable >(std::move(table));
+    return entry.get();
+  }
+
+  const AnimationTable* find(const std::string& name) const
+  {
+    auto found = tables.find(name);
+    return found == tables.end() ? nullptr : found->second.get();
+  }
+};
+
+// Playback state, advanced by animate_sprites()
+struct SpriteAnimation
+{
+  const AnimationTable* table = nullptr;
+  float time = 0;
+  std::uint32_t frame = 0;
+  float speed = 1;
+  bool playing = true;
+
+  void play(const AnimationTable* animation)
+  {
+    table = animation;
+    time = 0;
+    frame = 0;
+    playing = true;
+  }
+};
+
+// How an animated entity is drawn. The quad is placed at `position`; when
+// the entity has a WorldTransform, `position` is in the entity's local
+// space and the quad is then transformed into the world.
+struct AnimatedSprite
+{
+  sf::Vector2f position;
+  sf::Vector2f origin;
+  sf::Vector2f scale{ 1.f, 1.f };
+  sf::Color color = sf::Color::White;
+  std::uint8_t layer = 0;
+  std::uint16_t depth = 0;
+};
+
+// Advances every SpriteAnimation in one pass over the packed pool
+inline void animate_sprites(entt::registry& r, std::chrono::milliseconds dt)
+{
+  const float seconds = dt.count() / 1000.f;
+  SpriteAnimation* animations = r.raw< SpriteAnimation >();
+  const std::size_t n = r.size< SpriteAnimation >();
+
+  for(std::size_t i = 0; i < n; ++i)
+  {
+    auto& animation = animations[i];
+    const AnimationTable* table = animation.table;
+    if(!animation.playing || !table || table->frames.empty() || table->frame_time <= 0)
+      continue;
+
+    animation.time += seconds * animation.speed;
+    if(animation.time < table->frame_time)
+      continue;
+
+    const auto steps = (std::uint32_t)(animation.time / table->frame_time);
+    animation.time -= steps * table->frame_time;
+    const std::uint32_t count = table->frames.size();
+    if(table->loop)
+      animation.frame = (animation.frame + steps) % count;
+    else if(animation.frame + steps >= count - 1)
+    {
+      animation.frame = count - 1;
+      animation.playing = false;
+    }
+    else
+      animation.frame += steps;
+  }
+}
+
+// Writes every animated sprite straight into the render queue's vertex
+// buffer, one vertex command per texture, layer and depth, so a crowd
+// sharing a sheet costs a single draw call.
+struct SpriteBatcher
+{
+  struct Batch
+  {
+    std::uint64_t key;
+    const sf::Texture* texture;
+    std::size_t count, offset;
+  };
+
+  std::pmr::vector< Batch > batches;
+  std::pmr::unordered_map< std::uint64_t, std::size_t > batch_index;
+
+  SpriteBatcher(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : batches(resource), batch_index(resource)
+  {
+  }
+
+  // Neighbouring sprites usually share a batch, so try the last one first
+  std::size_t find_batch(std::uint64_t key, std::size_t hint) const
+  {
+    if(hint < batches.size() && batches[hint].key == key)
+      return hint;
+    auto found = batch_index.find(key);
+    return found == batch_index.end() ? batches.size() : found->second;
+  }
+
+  // Lays the quad out around `position` and applies `transform`, if any,
+  // on top
+  static void write_quad(sf::Vertex* out, const AnimatedSprite& sprite, const AnimationTable::Frame& frame, const sf::Transform* transform)
+  {
+    const sf::Vector2f min(sprite.position.x - sprite.origin.x * sprite.scale.x, sprite.position.y - sprite.origin.y * sprite.scale.y);
+    const sf::Vector2f max(min.x + frame.size.x * sprite.scale.x, min.y + frame.size.y * sprite.scale.y);
+    sf::Vector2f corners[4] = { min, { max.x, min.y }, max, { min.x, max.y } };
+    if(transform)
+      for(auto& corner : corners)
+        corner = transform->transformPoint(corner);
+
+    out[0] = sf::Vertex(corners[0], sprite.color, { frame.left, frame.top });
+    out[1] = sf::Vertex(corners[1], sprite.color, { frame.right, frame.top });
+    out[2] = sf::Vertex(corners[2], sprite.color, { frame.right, frame.bottom });
+    out[3] = out[0];
+    out[4] = out[2];
+    out[5] = sf::Vertex(corners[3], sprite.color, { frame.left, frame.bottom });
+  }
+
+  void submit(entt::registry& r, RenderQueue& queue)
+  {
+    batches.clear();
+    batch_index.clear();
+    auto view = r.view< const SpriteAnimation, const AnimatedSprite >();
+
+    // Count quads per batch
+    std::size_t hint = 0;
+    for(auto entity : view)
+    {
+      const auto& animation = view.get< const SpriteAnimation >(entity);
+      if(!animation.table || animation.table->frames.empty())
+        continue;
+      const auto& sprite = view.get< const AnimatedSprite >(entity);
+      const std::uint64_t key = SortKey::make(sprite.layer, sprite.depth, sf::BlendAlpha, animation.table->texture);
+      hint = find_batch(key, hint);
+      if(hint == batches.size())
+      {
+        batch_index.emplace(key, hint);
+        batches.push_back({ key, animation.table->texture, 0, 0 });
+      }
+      ++batches[hint].count;
+    }
+    if(batches.empty())
+      return;
+
+    // Reserve each batch's vertices; the queue's buffer may grow while
+    // reserving, so keep offsets rather than pointers
+    for(auto& batch : batches)
+    {
+      sf::Vertex* first = queue.submit_vertices(batch.key, batch.count * 6, batch.texture);
+      batch.offset = first - queue.vertices.data();
+    }
+
+    sf::Vertex* vertices = queue.vertices.data();
+    hint = 0;
+    for(auto entity : view)
+    {
+      const auto& animation = view.get< const SpriteAnimation >(entity);
+      if(!animation.table || animation.table->frames.empty())
+        continue;
+      const auto& sprite = view.get< const AnimatedSprite >(entity);
+      const std::uint64_t key = SortKey::make(sprite.layer, sprite.depth, sf::BlendAlpha, animation.table->texture);
+      hint = find_batch(key, hint);
+
+      const auto* world = r.try_get< WorldTransform >(entity);
+      const auto& frame = animation.table->frames[std::min< std::size_t >(animation.frame, animation.table->frames.size() - 1)];
+      write_quad(vertices + batches[hint].offset, sprite, frame, world ? &world->matrix : nullptr);
+      batches[hint].offset += 6;
+    }
+  }
+};
+
+} // ::UI
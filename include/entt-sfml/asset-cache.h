@@ -1,6 +1,12 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <array>
+#include <chrono>
+#include <future>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 namespace UI
@@ -12,19 +18,26 @@ struct AssetRecord
   using Self = AssetRecord<Asset>;
 
   std::string path;
+  // Owned by this record, or null when the asset belongs to a shared cache
   std::unique_ptr< Asset > asset;
+  Asset* borrowed = nullptr;
 
   AssetRecord(const std::string& path, std::unique_ptr< Asset >&& asset)
   : path(path), asset(std::move(asset))
   {
   }
 
+  AssetRecord(const std::string& path, Asset* borrowed)
+  : path(path), asset(nullptr), borrowed(borrowed)
+  {
+  }
+
   AssetRecord()
   : asset(nullptr)
   {}
 
   AssetRecord(Self&& other)
-  : path(std::move(other.path)), asset(std::move(other.asset))
+  : path(std::move(other.path)), asset(std::move(other.asset)), borrowed(other.borrowed)
   {
   }
 
@@ -32,8 +45,22 @@ struct AssetRecord
   {
     path = std::move(other.path);
     asset = std::move(other.asset);
+    borrowed = other.borrowed;
     return *this;
   }
+
+  Asset* get() const
+  {
+    return asset ? asset.get() : borrowed;
+  }
+};
+
+// Something an AssetCache can defer to instead of loading its own copy
+template< typename Asset >
+struct AssetSource
+{
+  virtual ~AssetSource() = default;
+  virtual Asset* get(const std::string& path) = 0;
 };
 
 template< typename Asset, typename Derived >
@@ -42,7 +69,16 @@ struct AssetCache
   using AssetType = Asset;
   Derived& derived() { return *static_cast< Derived* >(this); }
 
-  std::unordered_map< std::string, AssetRecord<Asset> > cache;
+  std::pmr::unordered_map< std::string, AssetRecord<Asset> > cache;
+
+  // When set, assets are loaded by the shared cache and the local records
+  // only borrow them
+  AssetSource< Asset >* shared = nullptr;
+
+  AssetCache(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : cache(resource)
+  {
+  }
 
   ~AssetCache()
   {
@@ -54,7 +90,7 @@ struct AssetCache
     auto asset = get_asset(path);
     if(!asset)
       return nullptr;
-    return asset->asset.get();
+    return asset->get();
   }
 
   AssetRecord<Asset>* get_asset(const std::string& path)
@@ -62,13 +98,180 @@ struct AssetCache
     const auto iter = cache.find(path);
     if(iter != cache.cend())
       return &iter->second;
+
+    if(shared)
+    {
+      Asset* asset = shared->get(path);
+      if(!asset)
+        return nullptr;
+      return &cache.insert({ path, AssetRecord<Asset>(path, asset) }).first->second;
+    }
+
     std::unique_ptr< Asset > asset = derived().load(path);
     if(!asset)
       return nullptr;
+    return &cache.insert({ path, AssetRecord<Asset>(path, std::move(asset)) }).first->second;
+  }
+};
 
-    cache.insert({ path, AssetRecord<Asset>(path, std::move(asset)) });
-    return &cache[path];
+// Process-wide cache safe to use from several threads. Lookups of loaded
+// assets only take a shared lock on one of the shards; when several threads
+// ask for the same missing path, one loads it and the others wait for it.
+// Failed loads are not cached and are retried on the next request.
+template< typename Asset, typename Derived >
+struct SharedAssetCache : AssetSource< Asset >
+{
+  using AssetType = Asset;
+  Derived& derived() { return *static_cast< Derived* >(this); }
+
+  struct Slot
+  {
+    std::unique_ptr< Asset > asset;
+    std::shared_future< Asset* > ready;
+  };
+
+  struct Shard
+  {
+    std::shared_mutex mutex;
+    std::unordered_map< std::string, std::unique_ptr< Slot > > slots;
+  };
+
+  std::array< Shard, 16 > shards;
+
+  Shard& shard_for(const std::string& path)
+  {
+    return shards[std::hash< std::string >{}(path) % shards.size()];
   }
+
+  Asset* get(const std::string& path) override
+  {
+    Shard& shard = shard_for(path);
+    {
+      std::shared_lock< std::shared_mutex > lock(shard.mutex);
+      auto iter = shard.slots.find(path);
+      if(iter != shard.slots.end())
+      {
+        auto ready = iter->second->ready;
+        lock.unlock();
+        return ready.get();
+      }
+    }
+
+    std::promise< Asset* > promise;
+    Slot* slot;
+    {
+      std::unique_lock< std::shared_mutex > lock(shard.mutex);
+      auto& entry = shard.slots[path];
+      if(entry)
+      {
+        // Another thread got here first
+        auto ready = entry->ready;
+        lock.unlock();
+        return ready.get();
+      }
+      entry = std::make_unique< Slot >();
+      entry->ready = promise.get_future().share();
+      slot = entry.get();
+    }
+
+    // Load outside the lock, other paths in this shard stay available. If
+    // loading throws, the waiting threads get the exception too and the
+    // path is retried on the next request.
+    try
+    {
+      slot->asset = derived().load(path);
+    }
+    catch(...)
+    {
+      promise.set_exception(std::current_exception());
+      std::unique_lock< std::shared_mutex > lock(shard.mutex);
+      shard.slots.erase(path);
+      throw;
+    }
+    Asset* asset = slot->asset.get();
+    promise.set_value(asset);
+
+    if(!asset)
+    {
+      std::unique_lock< std::shared_mutex > lock(shard.mutex);
+      shard.slots.erase(path);
+    }
+    return asset;
+  }
+
+  // Calls fn(path, asset) for every asset that has finished loading
+  template< typename Func >
+  void each(Func fn)
+  {
+    for(auto& shard : shards)
+    {
+      std::shared_lock< std::shared_mutex > lock(shard.mutex);
+      for(auto& item : shard.slots)
+      {
+        auto& ready = item.second->ready;
+        if(ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready && ready.get())
+          fn(item.first, *ready.get());
+      }
+    }
+  }
+
+  std::size_t size()
+  {
+    std::size_t count = 0;
+    for(auto& shard : shards)
+    {
+      std::shared_lock< std::shared_mutex > lock(shard.mutex);
+      count += shard.slots.size();
+    }
+    return count;
+  }
+};
+
+struct FontLoader
+{
+  static std::unique_ptr< sf::Font > load(const std::string& file)
+  {
+    sf::Font font;
+    if(! font.loadFromFile(file))
+      return nullptr;
+    return std::make_unique< sf::Font >(font);
+  }
+};
+
+struct TextureLoader
+{
+  static std::unique_ptr< sf::Texture > load(const std::string& file)
+  {
+    sf::Texture tex;
+    if(!tex.loadFromFile(file))
+      return nullptr;
+    return std::make_unique< sf::Texture >(tex);
+  }
+};
+
+struct FontCache : AssetCache< sf::Font, FontCache >, FontLoader
+{
+  using AssetCache< sf::Font, FontCache >::AssetCache;
+};
+
+struct TextureCache : AssetCache< sf::Texture, TextureCache >, TextureLoader
+{
+  using AssetCache< sf::Texture, TextureCache >::AssetCache;
+};
+
+struct SharedFontCache : SharedAssetCache< sf::Font, SharedFontCache >, FontLoader
+{
+};
+
+struct SharedTextureCache : SharedAssetCache< sf::Texture, SharedTextureCache >, TextureLoader
+{
+};
+
+// Caches shared by every registry in the process, see RegistryMixin::ui_init
+struct SharedAssets
+{
+  SharedFontCache fonts;
+  SharedTextureCache textures;
 };
 
 } // ::UI
@@ -0,0 +1,326 @@
+#pragma once
+
+#include "events.h"
+#include "hierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <vector>
+
+namespace UI
+{
+
+  // Collision shape relative to the entity's position. Circles are centered
+  // on position + offset; rects span from position + offset to
+  // position + offset + size and are not rotated.
+  struct Collider
+  {
+    enum Shape : std::uint8_t { Circle, Rect };
+
+    Shape shape = Circle;
+    float radius = 0;
+    sf::Vector2f size;
+    sf::Vector2f offset;
+    // Two colliders interact if either one's layer is in the other's mask
+    std::uint32_t layer = 1;
+    std::uint32_t mask = 0xFFFFFFFF;
+  };
+
+  // Tags entities that already have a broadphase proxy
+  struct InBroadphase
+  {
+  };
+
+  struct Contact
+  {
+    std::uint64_t key;
+    entt::entity a, b;
+    sf::Vector2f normal;
+    float depth;
+  };
+
+  // Narrowphase tests; on overlap fill in the normal (from a to b) and depth
+  namespace Collision
+  {
+    inline bool circle_circle(sf::Vector2f ca, float ra, sf::Vector2f cb, float rb, sf::Vector2f& normal, float& depth)
+    {
+      sf::Vector2f d = cb - ca;
+      float r = ra + rb;
+      float dist2 = d.x * d.x + d.y * d.y;
+      if(dist2 >= r * r)
+        return false;
+      float dist = std::sqrt(dist2);
+      normal = dist > 0 ? d / dist : sf::Vector2f(1.f, 0.f);
+      depth = r - dist;
+      return true;
+    }
+
+    inline bool rect_rect(const sf::FloatRect& a, const sf::FloatRect& b, sf::Vector2f& normal, float& depth)
+    {
+      float dx = std::min(a.left + a.width, b.left + b.width) - std::max(a.left, b.left);
+      float dy = std::min(a.top + a.height, b.top + b.height) - std::max(a.top, b.top);
+      if(dx <= 0 || dy <= 0)
+        return false;
+      if(dx < dy)
+      {
+        normal = sf::Vector2f(a.left + a.width / 2 < b.left + b.width / 2 ? 1.f : -1.f, 0.f);
+        depth = dx;
+      }
+      else
+      {
+        normal = sf::Vector2f(0.f, a.top + a.height / 2 < b.top + b.height / 2 ? 1.f : -1.f);
+        depth = dy;
+      }
+      return true;
+    }
+
+    // Normal points from the circle to the rect
+    inline bool circle_rect(sf::Vector2f c, float r, const sf::FloatRect& rect, sf::Vector2f& normal, float& depth)
+    {
+      sf::Vector2f closest(
+        std::clamp(c.x, rect.left, rect.left + rect.width),
+        std::clamp(c.y, rect.top, rect.top + rect.height));
+      sf::Vector2f d = closest - c;
+      float dist2 = d.x * d.x + d.y * d.y;
+
+      if(dist2 > 0)
+      {
+        if(dist2 >= r * r)
+          return false;
+        float dist = std::sqrt(dist2);
+        normal = d / dist;
+        depth = r - dist;
+        return true;
+      }
+
+      // Center inside the rect, push out through the nearest edge
+      float left = c.x - rect.left, right = rect.left + rect.width - c.x;
+      float top = c.y - rect.top, bottom = rect.top + rect.height - c.y;
+      float nearest = std::min({ left, right, top, bottom });
+      if(nearest == left)
+        normal = sf::Vector2f(1.f, 0.f);
+      else if(nearest == right)
+        normal = sf::Vector2f(-1.f, 0.f);
+      else if(nearest == top)
+        normal = sf::Vector2f(0.f, 1.f);
+      else
+        normal = sf::Vector2f(0.f, -1.f);
+      depth = r + nearest;
+      return true;
+    }
+  }
+
+  // Sort-and-sweep broadphase. Proxies stay sorted on their left edge
+  // between frames, so the per-frame insertion sort is close to linear while
+  // bodies move coherently. Contact begin/end events are queued on the
+  // registry's dispatcher by diffing this frame's pairs with the last.
+  struct CollisionWorld
+  {
+    struct Proxy
+    {
+      entt::entity entity;
+      float min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+      sf::Vector2f position;
+      Collider collider;
+      // False while the entity has no position
+      bool placed = false;
+    };
+
+    std::pmr::vector< Proxy > proxies;
+    std::pmr::vector< entt::entity > added;
+    std::pmr::vector< Contact > contacts, previous_contacts;
+
+    CollisionWorld(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : proxies(resource), added(resource), contacts(resource), previous_contacts(resource)
+    {
+    }
+
+    std::size_t memory_usage() const
+    {
+      return proxies.capacity() * sizeof(Proxy)
+        + added.capacity() * sizeof(entt::entity)
+        + (contacts.capacity() + previous_contacts.capacity()) * sizeof(Contact);
+    }
+
+    void on_add_collider(entt::registry&, entt::entity entity)
+    {
+      added.push_back(entity);
+    }
+
+    static std::uint64_t pair_key(entt::entity a, entt::entity b)
+    {
+      std::uint64_t x = entt::to_integral(a), y = entt::to_integral(b);
+      return x < y ? (x << 32 | y) : (y << 32 | x);
+    }
+
+    // Updates a proxy's bounds, returns false if its collider is gone
+    template< typename Position >
+    static bool refresh(entt::registry& r, Proxy& proxy, Position& position)
+    {
+      if(! r.valid(proxy.entity))
+        return false;
+      auto collider = r.try_get< Collider >(proxy.entity);
+      if(!collider)
+      {
+        r.remove_if_exists< InBroadphase >(proxy.entity);
+        return false;
+      }
+      proxy.collider = *collider;
+      sf::Vector2f at;
+      proxy.placed = position(proxy.entity, at);
+      if(!proxy.placed)
+        return true;
+      proxy.position = at + collider->offset;
+      if(collider->shape == Collider::Circle)
+      {
+        proxy.min_x = proxy.position.x - collider->radius;
+        proxy.max_x = proxy.position.x + collider->radius;
+        proxy.min_y = proxy.position.y - collider->radius;
+        proxy.max_y = proxy.position.y + collider->radius;
+      }
+      else
+      {
+        proxy.min_x = proxy.position.x;
+        proxy.max_x = proxy.position.x + collider->size.x;
+        proxy.min_y = proxy.position.y;
+        proxy.max_y = proxy.position.y + collider->size.y;
+      }
+      return true;
+    }
+
+    // `position(entity, out)` sets each collider's world position and returns
+    // false for entities that have none yet; those take no part in contacts
+    template< typename Position >
+    void update(entt::registry& r, Position position)
+    {
+      // Refresh bounds, dropping proxies whose collider is gone
+      proxies.erase(
+        std::remove_if(proxies.begin(), proxies.end(),
+          [&](Proxy& proxy){ return ! refresh(r, proxy, position); }),
+        proxies.end());
+
+      // Insertion sort, nearly sorted from last frame
+      for(std::size_t i = 1; i < proxies.size(); ++i)
+      {
+        if(!(proxies[i].min_x < proxies[i - 1].min_x))
+          continue;
+        Proxy proxy = proxies[i];
+        std::size_t j = i;
+        for(; j > 0 && proxy.min_x < proxies[j - 1].min_x; --j)
+          proxies[j] = proxies[j - 1];
+        proxies[j] = proxy;
+      }
+
+      // New proxies arrive in no particular order, so sort them on their own
+      // and merge them in rather than insertion sorting them into place
+      const std::size_t sorted = proxies.size();
+      for(auto entity : added)
+      {
+        if(! r.valid(entity) || r.has< InBroadphase >(entity))
+          continue;
+        Proxy proxy{ entity };
+        if(! refresh(r, proxy, position))
+          continue;
+        r.emplace< InBroadphase >(entity);
+        proxies.push_back(proxy);
+      }
+      added.clear();
+      if(proxies.size() > sorted)
+      {
+        auto by_min_x = [](const Proxy& a, const Proxy& b){ return a.min_x < b.min_x; };
+        std::sort(proxies.begin() + sorted, proxies.end(), by_min_x);
+        std::inplace_merge(proxies.begin(), proxies.begin() + sorted, proxies.end(), by_min_x);
+      }
+
+      previous_contacts.swap(contacts);
+      contacts.clear();
+
+      for(std::size_t i = 0; i < proxies.size(); ++i)
+      {
+        const Proxy& a = proxies[i];
+        if(!a.placed)
+          continue;
+        for(std::size_t j = i + 1; j < proxies.size() && proxies[j].min_x <= a.max_x; ++j)
+        {
+          const Proxy& b = proxies[j];
+          if(!b.placed || b.min_y > a.max_y || b.max_y < a.min_y)
+            continue;
+          if(!(a.collider.layer & b.collider.mask) && !(b.collider.layer & a.collider.mask))
+            continue;
+
+          Contact contact;
+          if(narrowphase(a, b, contact.normal, contact.depth))
+          {
+            contact.a = a.entity;
+            contact.b = b.entity;
+            contact.key = pair_key(a.entity, b.entity);
+            contacts.push_back(contact);
+          }
+        }
+      }
+
+      std::sort(contacts.begin(), contacts.end(),
+        [](const Contact& x, const Contact& y){ return x.key < y.key; });
+
+      dispatch(r);
+    }
+
+    // Colliders without a WorldTransform are left out until they get one
+    void update(entt::registry& r)
+    {
+      update(r,
+        [&](entt::entity entity, sf::Vector2f& out)
+        {
+          auto world = r.try_get< WorldTransform >(entity);
+          if(world)
+            out = world->position();
+          return world != nullptr;
+        });
+    }
+
+    static bool narrowphase(const Proxy& a, const Proxy& b, sf::Vector2f& normal, float& depth)
+    {
+      const bool a_circle = a.collider.shape == Collider::Circle;
+      const bool b_circle = b.collider.shape == Collider::Circle;
+      const sf::FloatRect a_rect(a.position, a.collider.size), b_rect(b.position, b.collider.size);
+
+      if(a_circle && b_circle)
+        return Collision::circle_circle(a.position, a.collider.radius, b.position, b.collider.radius, normal, depth);
+      if(a_circle)
+        return Collision::circle_rect(a.position, a.collider.radius, b_rect, normal, depth);
+      if(b_circle)
+      {
+        bool hit = Collision::circle_rect(b.position, b.collider.radius, a_rect, normal, depth);
+        normal = -normal;
+        return hit;
+      }
+      return Collision::rect_rect(a_rect, b_rect, normal, depth);
+    }
+
+    // Both contact lists are sorted by key, walk them together
+    void dispatch(entt::registry& r)
+    {
+      auto& dispatcher = r.ctx< entt::dispatcher >();
+      std::size_t i = 0, j = 0;
+      while(i < contacts.size() || j < previous_contacts.size())
+      {
+        if(j == previous_contacts.size() || (i < contacts.size() && contacts[i].key < previous_contacts[j].key))
+        {
+          const auto& c = contacts[i++];
+          dispatcher.enqueue(ContactBeginEvent{ c.a, c.b, c.normal, c.depth });
+        }
+        else if(i == contacts.size() || previous_contacts[j].key < contacts[i].key)
+        {
+          const auto& c = previous_contacts[j++];
+          dispatcher.enqueue(ContactEndEvent{ c.a, c.b });
+        }
+        else
+        {
+          ++i;
+          ++j;
+        }
+      }
+    }
+  };
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "controllers/controller.h"
+#include "update-lod.h"
 #include <iostream>
+#include <memory_resource>
 
 namespace UI
 {
@@ -51,20 +53,35 @@ namespace UI
   {
     using ControllerReference = std::shared_ptr< UI::Controllers::Controller >;
 
-    std::unordered_map< std::string, ControllerReference > controllers;
+    std::pmr::memory_resource* resource;
+    std::pmr::unordered_map< std::string, ControllerReference > controllers;
+
+    // Pass `resource` on to the controllers' create() so they are allocated
+    // from the same memory as the map
+    ControllerManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : resource(resource), controllers(resource)
+    {
+    }
 
     void add_controller(const std::string& name, const ControllerReference& controller)
     {
       controllers[name] = controller;
     }
     
-    void update(entt::registry& r, std::chrono::milliseconds dt)
+    // With `headless`, controllers that poll input devices are skipped
+    void update(entt::registry& r, std::chrono::milliseconds dt, bool headless = false)
     {
+      auto scheduler = r.try_ctx< UpdateScheduler >();
       for(const auto& controller_pair : controllers)
       {
         auto& ctr = controller_pair.second;
-        if(ctr && r.valid(ctr->entity))
-          ctr->update(r, dt);
+        if(!ctr || ! r.valid(ctr->entity) || (headless && ctr->polls_device()))
+          continue;
+
+        auto ctr_dt = dt;
+        if(scheduler && ! scheduler->due(r, ctr->entity, ctr_dt))
+          continue;
+        ctr->update(r, ctr_dt);
       }
     }
 
@@ -21,6 +21,13 @@ struct Controller
 
   virtual void update(entt::registry&, std::chrono::milliseconds) = 0;
 
+  // True for controllers that poll a local input device, which needs a
+  // display and is skipped in headless worlds
+  virtual bool polls_device() const
+  {
+    return false;
+  }
+
   void release()
   {
     entity = entt::null;
@@ -2,6 +2,7 @@
 
 #include "controller.h"
 #include "../events.h"
+#include <memory_resource>
 
 namespace UI::Controllers
 {
@@ -11,13 +12,18 @@ struct Keyboard : Controller
   static const std::unordered_map< sf::Keyboard::Key, std::string > key_to_name;
   static const std::unordered_map< std::string, sf::Keyboard::Key > name_to_key;
 
-  std::unordered_map< sf::Keyboard::Key, std::string > controls;
+  std::pmr::unordered_map< sf::Keyboard::Key, std::string > controls;
 
-  Keyboard()
-  : Controller()
+  Keyboard(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : Controller(), controls(resource)
   {
   }
 
+  bool polls_device() const override
+  {
+    return true;
+  }
+
   void update(entt::registry& r, std::chrono::milliseconds dt)
   {
     auto& dispatcher = r.ctx< entt::dispatcher >();
@@ -31,10 +37,10 @@ struct Keyboard : Controller
     }
   }
 
-  static std::shared_ptr< Keyboard > create(const std::unordered_map< std::string, std::string >& map)
+  static std::shared_ptr< Keyboard > create(const std::unordered_map< std::string, std::string >& map, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
   {
     // Does not set the `name` field
-    auto controller = std::make_shared< Keyboard >();
+    auto controller = std::allocate_shared< Keyboard >(std::pmr::polymorphic_allocator< Keyboard >(resource), resource);
     for(const auto& item : map)
     {
       const auto& key = item.first;
@@ -2,6 +2,7 @@
 
 #include "controller.h"
 #include "../events.h"
+#include <memory_resource>
 
 namespace UI::Controllers
 {
@@ -11,13 +12,18 @@ struct Mouse : Controller
   static const std::unordered_map< sf::Mouse::Button, std::string > button_to_name;
   static const std::unordered_map< std::string, sf::Mouse::Button > name_to_button;
 
-  std::unordered_map< sf::Mouse::Button, std::string > controls;
+  std::pmr::unordered_map< sf::Mouse::Button, std::string > controls;
 
-  Mouse()
-  : Controller()
+  Mouse(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : Controller(), controls(resource)
   {
   }
 
+  bool polls_device() const override
+  {
+    return true;
+  }
+
   void update(entt::registry& r, std::chrono::milliseconds dt)
   {
     auto& dispatcher = r.ctx< entt::dispatcher >();
@@ -31,10 +37,10 @@ struct Mouse : Controller
     }
   }
 
-  static std::shared_ptr< Mouse > create(const std::unordered_map< std::string, std::string >& map)
+  static std::shared_ptr< Mouse > create(const std::unordered_map< std::string, std::string >& map, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
   {
     // Does not set the `name` field
-    auto controller = std::make_shared< Mouse >();
+    auto controller = std::allocate_shared< Mouse >(std::pmr::polymorphic_allocator< Mouse >(resource), resource);
     for(const auto& item : map)
     {
       const auto& key = item.first;
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <chrono>
+#include <cstdint>
 #include <string>
 
 namespace UI
@@ -18,6 +19,21 @@ namespace UI
   struct RenderDrawableEvent
   {
     std::unique_ptr< sf::Drawable > drawable;
+    std::uint64_t sort_key = 0;
+  };
+
+
+  // Delivered when two colliders start overlapping; normal points from a to b
+  struct ContactBeginEvent
+  {
+    entt::entity a, b;
+    sf::Vector2f normal;
+    float depth;
+  };
+
+  struct ContactEndEvent
+  {
+    entt::entity a, b;
   };
 
 }
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <SFML/Graphics/Transform.hpp>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace UI
+{
+
+  // Intrusive parent/child links; children form a doubly linked list
+  struct Relationship
+  {
+    entt::entity parent = entt::null;
+    entt::entity first_child = entt::null;
+    entt::entity prev_sibling = entt::null;
+    entt::entity next_sibling = entt::null;
+    std::size_t children = 0;
+  };
+
+  struct LocalTransform
+  {
+    sf::Transform matrix;
+  };
+
+  // Written by TransformHierarchy::update, parent world * local
+  struct WorldTransform
+  {
+    sf::Transform matrix;
+
+    sf::Vector2f position() const
+    {
+      return matrix.transformPoint(0.f, 0.f);
+    }
+  };
+
+  // Tag for entities whose local transform or parent changed this frame
+  struct TransformDirty
+  {
+  };
+
+  inline void mark_transform_dirty(entt::registry& r, entt::entity entity)
+  {
+    if(! r.has< TransformDirty >(entity))
+      r.emplace< TransformDirty >(entity);
+  }
+
+  inline void set_local_transform(entt::registry& r, entt::entity entity, const sf::Transform& matrix)
+  {
+    r.emplace_or_replace< LocalTransform >(entity, LocalTransform{ matrix });
+    mark_transform_dirty(r, entity);
+  }
+
+  inline bool is_ancestor(entt::registry& r, entt::entity ancestor, entt::entity entity)
+  {
+    auto rel = r.try_get< Relationship >(entity);
+    while(rel && rel->parent != entt::null)
+    {
+      if(rel->parent == ancestor)
+        return true;
+      rel = r.try_get< Relationship >(rel->parent);
+    }
+    return false;
+  }
+
+  // Removes `child` from its parent's list of children without touching
+  // the child's transform, safe to call while `child` is being destroyed
+  inline void unlink(entt::registry& r, entt::entity child)
+  {
+    auto rel = r.try_get< Relationship >(child);
+    if(!rel || rel->parent == entt::null)
+      return;
+
+    auto& parent = r.get< Relationship >(rel->parent);
+    if(parent.first_child == child)
+      parent.first_child = rel->next_sibling;
+    if(rel->prev_sibling != entt::null)
+      r.get< Relationship >(rel->prev_sibling).next_sibling = rel->next_sibling;
+    if(rel->next_sibling != entt::null)
+      r.get< Relationship >(rel->next_sibling).prev_sibling = rel->prev_sibling;
+    --parent.children;
+
+    rel->parent = rel->prev_sibling = rel->next_sibling = entt::null;
+  }
+
+  inline void detach(entt::registry& r, entt::entity child)
+  {
+    auto rel = r.try_get< Relationship >(child);
+    if(!rel || rel->parent == entt::null)
+      return;
+
+    unlink(r, child);
+    mark_transform_dirty(r, child);
+  }
+
+  inline bool attach(entt::registry& r, entt::entity child, entt::entity parent)
+  {
+    if(! r.valid(child) || ! r.valid(parent) || child == parent || is_ancestor(r, child, parent))
+      return false;
+
+    detach(r, child);
+
+    auto& parent_rel = r.get_or_emplace< Relationship >(parent);
+    auto& child_rel = r.get_or_emplace< Relationship >(child);
+    child_rel.parent = parent;
+    child_rel.next_sibling = parent_rel.first_child;
+    if(parent_rel.first_child != entt::null)
+      r.get< Relationship >(parent_rel.first_child).prev_sibling = child;
+    parent_rel.first_child = child;
+    ++parent_rel.children;
+
+    mark_transform_dirty(r, child);
+    return true;
+  }
+
+  // Children of a destroyed entity become roots. The entity itself is not
+  // marked dirty: its TransformDirty pool may already have been cleared, and
+  // the tag would outlive it.
+  inline void on_remove_relationship(entt::registry& r, entt::entity entity)
+  {
+    unlink(r, entity);
+
+    auto& rel = r.get< Relationship >(entity);
+    auto child = rel.first_child;
+    while(child != entt::null)
+    {
+      auto& child_rel = r.get< Relationship >(child);
+      auto next = child_rel.next_sibling;
+      child_rel.parent = child_rel.prev_sibling = child_rel.next_sibling = entt::null;
+      mark_transform_dirty(r, child);
+      child = next;
+    }
+    rel.first_child = entt::null;
+    rel.children = 0;
+  }
+
+
+
+  struct TransformHierarchy
+  {
+    std::pmr::vector< entt::entity > roots;
+    std::pmr::vector< std::pair< entt::entity, sf::Transform > > stack;
+
+    TransformHierarchy(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : roots(resource), stack(resource)
+    {
+    }
+
+    // Recomputes world transforms for dirty entities and their descendants,
+    // parents before children. Clean subtrees are not visited.
+    void update(entt::registry& r)
+    {
+      roots.clear();
+      r.view< TransformDirty >().each(
+        [&](auto entity)
+        {
+          // Skip entities that will be reached from a dirty ancestor
+          auto rel = r.try_get< Relationship >(entity);
+          while(rel && rel->parent != entt::null)
+          {
+            if(r.has< TransformDirty >(rel->parent))
+              return;
+            rel = r.try_get< Relationship >(rel->parent);
+          }
+          roots.push_back(entity);
+        }
+      );
+
+      for(auto root : roots)
+      {
+        sf::Transform parent_world;
+        auto rel = r.try_get< Relationship >(root);
+        if(rel && rel->parent != entt::null)
+          if(auto world = r.try_get< WorldTransform >(rel->parent))
+            parent_world = world->matrix;
+
+        stack.emplace_back(root, parent_world);
+        while(! stack.empty())
+        {
+          auto [entity, world] = stack.back();
+          stack.pop_back();
+
+          if(auto local = r.try_get< LocalTransform >(entity))
+            world *= local->matrix;
+          r.emplace_or_replace< WorldTransform >(entity, WorldTransform{ world });
+
+          auto node = r.try_get< Relationship >(entity);
+          if(!node)
+            continue;
+          for(auto child = node->first_child; child != entt::null;
+            child = r.get< Relationship >(child).next_sibling)
+            stack.emplace_back(child, world);
+        }
+      }
+
+      r.clear< TransformDirty >();
+    }
+  };
+
+  template<typename Registry>
+  struct UpdateTransforms
+  {
+    void operator() (Registry& registry)
+    {
+      auto& hierarchy = registry.template ctx< TransformHierarchy >();
+      hierarchy.update(registry);
+    }
+  };
+
+}
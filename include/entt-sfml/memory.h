@@ -0,0 +1,170 @@
+#pragma once
+
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+# include <sys/mman.h>
+#endif
+
+namespace UI
+{
+
+// Forwards to an upstream resource, tracking usage and refusing
+// allocations past `limit` bytes (0 = unlimited) with std::bad_alloc
+struct AccountingResource : std::pmr::memory_resource
+{
+  std::pmr::memory_resource* upstream;
+  std::size_t limit;
+  std::size_t used = 0;
+  std::size_t peak = 0;
+  std::size_t allocations = 0;
+
+  AccountingResource(std::size_t limit = 0, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+  : upstream(upstream), limit(limit)
+  {
+  }
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    if(limit && used + bytes > limit)
+      throw std::bad_alloc();
+    void* p = upstream->allocate(bytes, alignment);
+    used += bytes;
+    ++allocations;
+    if(used > peak)
+      peak = used;
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+  {
+    upstream->deallocate(p, bytes, alignment);
+    used -= bytes;
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// Hands out whole 2MB-rounded mappings backed by huge pages where the OS
+// allows it. Meant as the upstream of an arena or pool, not for small
+// allocations.
+struct HugePageResource : std::pmr::memory_resource
+{
+  static constexpr std::size_t page_size = 2 * 1024 * 1024;
+
+  static std::size_t round_up(std::size_t bytes)
+  {
+    return (bytes + page_size - 1) / page_size * page_size;
+  }
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+#ifdef __linux__
+    const std::size_t size = round_up(bytes);
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p == MAP_FAILED)
+    {
+      // No reserved huge pages, ask for transparent ones instead
+      p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(p == MAP_FAILED)
+        throw std::bad_alloc();
+      madvise(p, size, MADV_HUGEPAGE);
+    }
+    return p;
+#else
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+#endif
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+  {
+#ifdef __linux__
+    munmap(p, round_up(bytes));
+#else
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+#endif
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// Memory for one world: a pool over an accounting resource, so every
+// container built on resource() is attributed to, and capped by, this world.
+// Owned by the caller and handed to RegistryMixin::ui_init, which builds on
+// it the render queue, transform hierarchy, collision world and sprite
+// batcher buffers, the font/texture cache maps, the controller map and
+// controllers created through ControllerManager::resource, and tilemaps
+// constructed with RegistryMixin::ui_memory_resource(). Not covered: EnTT's
+// component pools, loaded fonts and textures themselves (SFML allocates
+// those), tilemap chunk vertex arrays, and script memory. It must outlive
+// the registry, see ui_init.
+struct WorldMemory
+{
+  AccountingResource accounting;
+  std::pmr::unsynchronized_pool_resource pool;
+
+  WorldMemory(std::size_t limit = 0, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+  : accounting(limit, upstream), pool(&accounting)
+  {
+  }
+
+  std::pmr::memory_resource* resource()
+  {
+    return &pool;
+  }
+};
+
+struct MemoryReport
+{
+  struct Entry
+  {
+    std::string name;
+    std::size_t count;
+    std::size_t bytes;
+  };
+
+  std::vector< Entry > entries;
+
+  MemoryReport& add(const std::string& name, std::size_t count, std::size_t bytes)
+  {
+    entries.push_back({ name, count, bytes });
+    return *this;
+  }
+
+  // Pool storage only: the packed component and entity arrays
+  template< typename Component >
+  MemoryReport& component(const entt::registry& r, const std::string& name)
+  {
+    const std::size_t capacity = r.capacity< Component >();
+    return add(name, r.size< Component >(), capacity * (sizeof(Component) + sizeof(entt::entity)));
+  }
+
+  std::size_t total() const
+  {
+    std::size_t bytes = 0;
+    for(const auto& entry : entries)
+      bytes += entry.bytes;
+    return bytes;
+  }
+
+  void print(std::ostream& out) const
+  {
+    for(const auto& entry : entries)
+      out << "  " << entry.name << ": " << entry.count << " items, " << entry.bytes << " bytes" << std::endl;
+    out << "  total: " << total() << " bytes" << std::endl;
+  }
+};
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#ifdef FOWL_ENTT_MRUBY
+
+#include <mruby/gc.h>
+#include <chrono>
+
+// mrb_incremental_gc() is exported by mruby's gc.c but is not part of its
+// public API. Define FOWL_ENTT_MRUBY_INCREMENTAL_GC when the mruby you link
+// against provides it; otherwise ScriptGC only uses mrb_full_gc().
+#ifdef FOWL_ENTT_MRUBY_INCREMENTAL_GC
+MRB_BEGIN_DECL
+void mrb_incremental_gc(mrb_state* mrb);
+MRB_END_DECL
+#endif
+
+namespace UI
+{
+
+// Takes the mruby garbage collector off the allocation path and runs it in
+// explicit, time-budgeted increments at a point in the frame chosen by the
+// caller. Automatic GC is only turned off by the first step(), so states
+// that never call it keep mruby's normal collector. While automatic GC is
+// off nothing is freed between steps, so the growth in live objects between
+// two steps is the number of objects scripts allocated in that frame.
+//
+// Without FOWL_ENTT_MRUBY_INCREMENTAL_GC every collection is a full one, run
+// when the heap outgrows max_growth. In generational mode (the mruby
+// default) an incremental step runs a whole minor collection, which the
+// budget cannot split; step() runs at most one per frame. If scripts had
+// turned the collector off (GC.disable) before the first step, step() does
+// not collect and detach() leaves it off.
+struct ScriptGC
+{
+  struct FrameStats
+  {
+    std::size_t allocations = 0;
+    std::size_t live_objects = 0;
+    std::size_t steps = 0;
+    std::chrono::microseconds pause{ 0 };
+    bool full = false;
+  };
+
+  std::chrono::microseconds budget{ 1000 };
+  // Run a full collection if the heap grows past this multiple of its size
+  // after the last completed cycle, e.g. when the budget is too small
+  double max_growth = 4.0;
+
+  FrameStats last_frame;
+  std::chrono::microseconds worst_pause{ 0 };
+  std::size_t cycles = 0;
+
+  std::size_t live_at_step = 0;
+  std::size_t live_after_cycle = 0;
+  bool attached = false;
+  // mrb->gc.disabled as it was before attach()
+  bool was_disabled = false;
+
+  void attach(mrb_state* mrb)
+  {
+    attached = true;
+    was_disabled = mrb->gc.disabled;
+    mrb->gc.disabled = TRUE;
+    live_at_step = live_after_cycle = mrb->gc.live;
+  }
+
+  void detach(mrb_state* mrb)
+  {
+    if(!attached)
+      return;
+    attached = false;
+    mrb->gc.disabled = was_disabled;
+  }
+
+  void step(mrb_state* mrb)
+  {
+    if(!attached)
+      attach(mrb);
+
+    using clock = std::chrono::steady_clock;
+    const auto started = clock::now();
+
+    FrameStats stats;
+    stats.allocations = mrb->gc.live > live_at_step ? mrb->gc.live - live_at_step : 0;
+
+    if(! was_disabled)
+    {
+      mrb->gc.disabled = FALSE;
+      if(live_after_cycle > 0 && mrb->gc.live > live_after_cycle * max_growth)
+      {
+        mrb_full_gc(mrb);
+        stats.full = true;
+        ++stats.steps;
+        ++cycles;
+        live_after_cycle = mrb->gc.live;
+      }
+#ifdef FOWL_ENTT_MRUBY_INCREMENTAL_GC
+      else
+      {
+        // At most one cycle per frame; an unfinished one resumes next frame
+        while(clock::now() - started < budget)
+        {
+          mrb_incremental_gc(mrb);
+          ++stats.steps;
+          if(mrb->gc.state == MRB_GC_STATE_ROOT)
+          {
+            ++cycles;
+            live_after_cycle = mrb->gc.live;
+            break;
+          }
+        }
+      }
+#endif
+      mrb->gc.disabled = TRUE;
+    }
+
+    stats.pause = std::chrono::duration_cast< std::chrono::microseconds >(clock::now() - started);
+    stats.live_objects = live_at_step = mrb->gc.live;
+    if(stats.pause > worst_pause)
+      worst_pause = stats.pause;
+    last_frame = stats;
+  }
+};
+
+} // ::UI
+
+#endif
@@ -0,0 +1,216 @@
+#pragma once
+
+#ifdef FOWL_ENTT_MRUBY
+
+#include <mruby/error.h>
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+namespace UI
+{
+
+// Runs per-entity script behaviors as fibers. A behavior calls
+// `wait(seconds)` (or `wait` for the next frame) to suspend itself; due
+// behaviors are resumed in wakeup order until the frame's time budget is
+// spent, and whatever is left over runs first next frame.
+struct ScriptScheduler
+{
+  // Behavior ids returned by start() pack a slot and the slot's generation,
+  // so stopping a finished behavior can't stop whichever reused its slot.
+  // Ids fit a fixnum: 52 bits with a 64 bit mrb_int, 30 bits otherwise. A
+  // slot whose generation runs out is retired rather than reused, so an id
+  // is never handed out twice.
+  using Id = std::uint64_t;
+  static constexpr std::uint32_t slot_bits = 20;
+  static constexpr std::uint32_t slot_mask = (1u << slot_bits) - 1;
+  static constexpr std::uint32_t generation_bits = sizeof(mrb_int) >= 8 ? 32 : 10;
+  static constexpr Id generation_mask = ((Id)1 << generation_bits) - 1;
+
+  struct Behavior
+  {
+    mrb_value fiber;
+    entt::entity entity = entt::null;
+    int priority = 0;
+    bool alive = false;
+    std::uint32_t generation = 0;
+  };
+
+  struct Wakeup
+  {
+    double time;
+    int priority;
+    std::uint64_t sequence;
+    std::uint32_t slot;
+  };
+
+  // Earliest time first, then highest priority, then first scheduled
+  struct Later
+  {
+    bool operator() (const Wakeup& a, const Wakeup& b) const
+    {
+      if(a.time != b.time)
+        return a.time > b.time;
+      if(a.priority != b.priority)
+        return a.priority < b.priority;
+      return a.sequence > b.sequence;
+    }
+  };
+
+  std::vector< Behavior > behaviors;
+  std::vector< std::uint32_t > free_ids;
+  std::priority_queue< Wakeup, std::vector< Wakeup >, Later > wakeups;
+  std::vector< Wakeup > rescheduled;
+
+  std::chrono::microseconds budget{ 2000 };
+  double now = 0;
+  std::uint64_t sequence = 0;
+
+  // Stats for the last update()
+  std::size_t resumed = 0;
+  bool over_budget = false;
+
+  // Raises a RuntimeError once every slot is in use
+  Id start(mrb_state* mrb, entt::entity entity, mrb_value block, int priority = 0)
+  {
+    if(free_ids.empty() && behaviors.size() > slot_mask)
+      mrb_raise(mrb, E_RUNTIME_ERROR, "too many script behaviors");
+
+    RClass* fiber_class = mrb_class_get(mrb, "Fiber");
+    mrb_value fiber = mrb_funcall_with_block(mrb, mrb_obj_value(fiber_class), mrb_intern_lit(mrb, "new"), 0, nullptr, block);
+    mrb_gc_register(mrb, fiber);
+
+    std::uint32_t slot;
+    if(free_ids.empty())
+    {
+      slot = behaviors.size();
+      behaviors.emplace_back();
+    }
+    else
+    {
+      slot = free_ids.back();
+      free_ids.pop_back();
+    }
+
+    auto& behavior = behaviors[slot];
+    behavior = Behavior{ fiber, entity, priority, true, behavior.generation };
+    wakeups.push({ now, priority, sequence++, slot });
+    return (Id)behavior.generation << slot_bits | slot;
+  }
+
+  // Does nothing if the behavior has already finished or been stopped
+  void stop(mrb_state* mrb, Id id)
+  {
+    const std::uint32_t slot = id & slot_mask;
+    if(slot >= behaviors.size() || behaviors[slot].generation != id >> slot_bits)
+      return;
+    stop_slot(mrb, slot);
+  }
+
+  void stop_slot(mrb_state* mrb, std::uint32_t slot)
+  {
+    auto& behavior = behaviors[slot];
+    if(! behavior.alive)
+      return;
+    mrb_gc_unregister(mrb, behavior.fiber);
+    behavior.alive = false;
+    behavior.fiber = mrb_nil_value();
+    behavior.generation = (behavior.generation + 1) & generation_mask;
+    // The slot is recycled once its stale wakeup is popped, see update()
+  }
+
+  // Generation 0 is only a slot's first use; once it comes round again the
+  // slot is retired
+  void recycle(std::uint32_t slot)
+  {
+    if(behaviors[slot].generation != 0)
+      free_ids.push_back(slot);
+  }
+
+  void update(mrb_state* mrb, entt::registry& r, mrb_value registry_value, std::chrono::milliseconds dt)
+  {
+    using clock = std::chrono::steady_clock;
+    const auto started = clock::now();
+    now += dt.count() / 1000.0;
+    resumed = 0;
+    over_budget = false;
+
+    while(! wakeups.empty() && wakeups.top().time <= now)
+    {
+      if(clock::now() - started >= budget)
+      {
+        over_budget = true;
+        break;
+      }
+
+      Wakeup wakeup = wakeups.top();
+      wakeups.pop();
+
+      // Behaviors may start others while running, so copy before resuming
+      Behavior behavior = behaviors[wakeup.slot];
+      if(! behavior.alive)
+      {
+        recycle(wakeup.slot);
+        continue;
+      }
+
+      mrb_value seconds;
+      if(! r.valid(behavior.entity) || ! resume(mrb, behavior, registry_value, seconds))
+      {
+        stop_slot(mrb, wakeup.slot);
+        recycle(wakeup.slot);
+        continue;
+      }
+      ++resumed;
+
+      // Rescheduled behaviors never run twice in the same frame
+      double delay = mrb_float_p(seconds) || mrb_fixnum_p(seconds) ? mrb_to_flo(mrb, seconds) : 0.0;
+      rescheduled.push_back({ now + (delay > 0 ? delay : 0), behavior.priority, sequence++, wakeup.slot });
+    }
+
+    for(const auto& wakeup : rescheduled)
+      wakeups.push(wakeup);
+    rescheduled.clear();
+  }
+
+  // Resumes the fiber, returns false once it has finished or raised
+  bool resume(mrb_state* mrb, const Behavior& behavior, mrb_value registry_value, mrb_value& result)
+  {
+    struct ResumeArgs
+    {
+      mrb_value fiber;
+      mrb_value argv[2];
+    } args{ behavior.fiber, { registry_value, mrb_fixnum_value((mrb_int)behavior.entity) } };
+
+    mrb_bool raised = false;
+    result = mrb_protect(mrb,
+      [](mrb_state* mrb, mrb_value data) -> mrb_value
+      {
+        auto& args = *(ResumeArgs*)mrb_cptr(data);
+        return mrb_fiber_resume(mrb, args.fiber, 2, args.argv);
+      },
+      mrb_cptr_value(mrb, &args), &raised);
+
+    if(raised)
+    {
+      mrb_print_error(mrb);
+      mrb->exc = nullptr;
+      return false;
+    }
+    return mrb_test(mrb_fiber_alive_p(mrb, behavior.fiber));
+  }
+
+  void clear(mrb_state* mrb)
+  {
+    for(std::uint32_t slot = 0; slot < behaviors.size(); ++slot)
+      stop_slot(mrb, slot);
+    behaviors.clear();
+    free_ids.clear();
+    wakeups = {};
+  }
+};
+
+} // ::UI
+
+#endif
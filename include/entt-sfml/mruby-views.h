@@ -0,0 +1,289 @@
+#pragma once
+
+#ifdef FOWL_ENTT_MRUBY
+
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+namespace UI
+{
+
+// Component fields scripts may read and write in place. Register with
+//   views.expose< Transform >("Transform")
+//     .field< float >("x", offsetof(Transform, x))
+//     .field< float >("y", offsetof(Transform, y));
+// and get a view from a script with registry.view("Transform", "x").
+struct ScriptViews
+{
+  enum class FieldType : std::uint8_t { Float, Int };
+
+  struct Field
+  {
+    std::size_t offset;
+    FieldType type;
+  };
+
+  struct Pool
+  {
+    ENTT_ID_TYPE type;
+    std::size_t stride;
+    std::function< char*(entt::registry&) > data;
+    std::function< std::size_t(entt::registry&) > size;
+    std::function< const entt::entity*(entt::registry&) > entities;
+    std::function< char*(entt::registry&, entt::entity) > find;
+    std::unordered_map< std::string, Field > fields;
+
+    // Throws std::invalid_argument if the field does not fit in the component
+    template< typename Value >
+    Pool& field(const std::string& name, std::size_t offset)
+    {
+      static_assert(std::is_same< Value, float >::value || std::is_same< Value, std::int32_t >::value,
+        "script views support float and std::int32_t fields");
+      if(offset > stride || sizeof(Value) > stride - offset)
+        throw std::invalid_argument("script view field " + name + " lies outside the component");
+      fields[name] = { offset, std::is_same< Value, float >::value ? FieldType::Float : FieldType::Int };
+      return *this;
+    }
+  };
+
+  std::unordered_map< std::string, std::unique_ptr< Pool > > pools;
+
+  // Live script views point at their Pool, so it is never replaced: exposing
+  // a name again returns the existing Pool, and exposing it as a different
+  // type throws std::invalid_argument
+  template< typename T >
+  Pool& expose(const std::string& name)
+  {
+    auto& pool = pools[name];
+    if(pool)
+    {
+      if(pool->type != entt::type_info< T >::id())
+        throw std::invalid_argument("script view " + name + " is already exposed as another component");
+      return *pool;
+    }
+    pool = std::make_unique< Pool >();
+    pool->type = entt::type_info< T >::id();
+    pool->stride = sizeof(T);
+    pool->data = [](entt::registry& r){ return reinterpret_cast< char* >(r.raw< T >()); };
+    pool->size = [](entt::registry& r){ return r.size< T >(); };
+    pool->entities = [](entt::registry& r){ return r.data< T >(); };
+    pool->find = [](entt::registry& r, entt::entity entity){ return reinterpret_cast< char* >(r.try_get< T >(entity)); };
+    return *pool;
+  }
+};
+
+// A script handle on one field of every component in a pool. It keeps no
+// pointer into the pool, each call looks up the pool's current storage, so
+// a view stays valid while components are added and removed.
+struct ScriptView
+{
+  entt::registry* registry;
+  ScriptViews::Pool* pool;
+  ScriptViews::Field field;
+
+  std::size_t size() const { return pool->size(*registry); }
+
+  static double read(const char* p, ScriptViews::FieldType type)
+  {
+    return type == ScriptViews::FieldType::Float ? *reinterpret_cast< const float* >(p) : *reinterpret_cast< const std::int32_t* >(p);
+  }
+
+  static void write(char* p, ScriptViews::FieldType type, double value)
+  {
+    if(type == ScriptViews::FieldType::Float)
+      *reinterpret_cast< float* >(p) = (float)value;
+    else
+      *reinterpret_cast< std::int32_t* >(p) = (std::int32_t)value;
+  }
+
+  // Calls fn(element) for every element of the view's field
+  template< typename Func >
+  void each(Func fn)
+  {
+    char* p = pool->data(*registry) + field.offset;
+    const std::size_t n = size();
+    for(std::size_t i = 0; i < n; ++i, p += pool->stride)
+      fn(p);
+  }
+};
+
+namespace ScriptViewMethods
+{
+  inline void free_view(mrb_state* mrb, void* p)
+  {
+    delete static_cast< ScriptView* >(p);
+  }
+
+  inline const mrb_data_type view_type = { "ComponentView", free_view };
+
+  inline ScriptView* get_view(mrb_state* mrb, mrb_value self)
+  {
+    return static_cast< ScriptView* >(mrb_data_get_ptr(mrb, self, &view_type));
+  }
+
+  inline mrb_value wrap(mrb_state* mrb, ScriptView* view)
+  {
+    RClass* klass = mrb_class_get(mrb, "ComponentView");
+    return mrb_obj_value(mrb_data_object_alloc(mrb, klass, view, &view_type));
+  }
+
+  inline mrb_value element(mrb_state* mrb, double value, ScriptViews::FieldType type)
+  {
+    if(type == ScriptViews::FieldType::Float)
+      return mrb_float_value(mrb, value);
+    return mrb_fixnum_value((mrb_int)value);
+  }
+
+  inline mrb_value size(mrb_state* mrb, mrb_value self)
+  {
+    auto view = get_view(mrb, self);
+    return view ? mrb_fixnum_value(view->size()) : mrb_nil_value();
+  }
+
+  inline mrb_value get(mrb_state* mrb, mrb_value self)
+  {
+    mrb_int index;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "i", &index) != 1)
+      return mrb_nil_value();
+    if(index < 0 || (std::size_t)index >= view->size())
+      mrb_raisef(mrb, E_INDEX_ERROR, "index %S out of view", mrb_fixnum_value(index));
+
+    const char* p = view->pool->data(*view->registry) + index * view->pool->stride + view->field.offset;
+    return element(mrb, ScriptView::read(p, view->field.type), view->field.type);
+  }
+
+  inline mrb_value set(mrb_state* mrb, mrb_value self)
+  {
+    mrb_int index;
+    mrb_float value;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "if", &index, &value) != 2)
+      return mrb_nil_value();
+    if(index < 0 || (std::size_t)index >= view->size())
+      mrb_raisef(mrb, E_INDEX_ERROR, "index %S out of view", mrb_fixnum_value(index));
+
+    char* p = view->pool->data(*view->registry) + index * view->pool->stride + view->field.offset;
+    ScriptView::write(p, view->field.type, value);
+    return element(mrb, ScriptView::read(p, view->field.type), view->field.type);
+  }
+
+  // The entity owning element `index`
+  inline mrb_value entity(mrb_state* mrb, mrb_value self)
+  {
+    mrb_int index;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "i", &index) != 1)
+      return mrb_nil_value();
+    if(index < 0 || (std::size_t)index >= view->size())
+      mrb_raisef(mrb, E_INDEX_ERROR, "index %S out of view", mrb_fixnum_value(index));
+    return mrb_fixnum_value((mrb_int)view->pool->entities(*view->registry)[index]);
+  }
+
+  inline mrb_value fill(mrb_state* mrb, mrb_value self)
+  {
+    mrb_float value;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "f", &value) != 1)
+      return mrb_nil_value();
+    view->each([&](char* p){ ScriptView::write(p, view->field.type, value); });
+    return self;
+  }
+
+  inline mrb_value scale(mrb_state* mrb, mrb_value self)
+  {
+    mrb_float factor;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "f", &factor) != 1)
+      return mrb_nil_value();
+    const auto type = view->field.type;
+    view->each([&](char* p){ ScriptView::write(p, type, ScriptView::read(p, type) * factor); });
+    return self;
+  }
+
+  inline mrb_value clamp(mrb_state* mrb, mrb_value self)
+  {
+    mrb_float min, max;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "ff", &min, &max) != 2)
+      return mrb_nil_value();
+    const auto type = view->field.type;
+    view->each([&](char* p){ ScriptView::write(p, type, std::clamp< double >(ScriptView::read(p, type), min, max)); });
+    return self;
+  }
+
+  inline mrb_value sum(mrb_state* mrb, mrb_value self)
+  {
+    auto view = get_view(mrb, self);
+    if(!view)
+      return mrb_nil_value();
+    double total = 0;
+    view->each([&](char* p){ total += ScriptView::read(p, view->field.type); });
+    return mrb_float_value(mrb, total);
+  }
+
+  // self[i] += other[entity of i] * scale, e.g. positions.add!(velocities, dt).
+  // Entities missing from the other view are skipped.
+  inline mrb_value add(mrb_state* mrb, mrb_value self)
+  {
+    mrb_value other_value;
+    mrb_float factor = 1.0;
+    auto view = get_view(mrb, self);
+    if(!view || mrb_get_args(mrb, "o|f", &other_value, &factor) < 1)
+      return mrb_nil_value();
+    auto other = get_view(mrb, other_value);
+    if(!other || other->registry != view->registry)
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "expected a ComponentView of the same registry");
+
+    auto& r = *view->registry;
+    const auto type = view->field.type, other_type = other->field.type;
+    char* p = view->pool->data(r) + view->field.offset;
+    const std::size_t n = view->size();
+
+    if(other->pool == view->pool)
+    {
+      const char* q = other->pool->data(r) + other->field.offset;
+      for(std::size_t i = 0; i < n; ++i, p += view->pool->stride, q += other->pool->stride)
+        ScriptView::write(p, type, ScriptView::read(p, type) + ScriptView::read(q, other_type) * factor);
+      return self;
+    }
+
+    const entt::entity* entities = view->pool->entities(r);
+    for(std::size_t i = 0; i < n; ++i, p += view->pool->stride)
+    {
+      const char* q = other->pool->find(r, entities[i]);
+      if(q)
+        ScriptView::write(p, type, ScriptView::read(p, type) + ScriptView::read(q + other->field.offset, other_type) * factor);
+    }
+    return self;
+  }
+
+  inline void define(mrb_state* mrb)
+  {
+    RClass* klass = mrb_define_class(mrb, "ComponentView", mrb->object_class);
+    MRB_SET_INSTANCE_TT(klass, MRB_TT_DATA);
+    MRuby::Class{ mrb, klass }
+      .define_method("size", size, MRB_ARGS_REQ(0))
+      .define_method("[]", get, MRB_ARGS_REQ(1))
+      .define_method("[]=", set, MRB_ARGS_REQ(2))
+      .define_method("entity", entity, MRB_ARGS_REQ(1))
+      .define_method("fill", fill, MRB_ARGS_REQ(1))
+      .define_method("scale!", scale, MRB_ARGS_REQ(1))
+      .define_method("clamp!", clamp, MRB_ARGS_REQ(2))
+      .define_method("sum", sum, MRB_ARGS_REQ(0))
+      .define_method("add!", add, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(1))
+    ;
+  }
+}
+
+} // ::UI
+
+#endif
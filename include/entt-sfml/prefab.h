@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace UI
+{
+
+// A component template for spawning many identical entities at once. Each
+// component is inserted for the whole range with a single pool insert.
+struct Prefab
+{
+  // Numeric spawn arguments, e.g. { {"x", 10}, {"spread", 50} }
+  using Params = std::unordered_map< std::string, float >;
+  using Step = std::function< void(entt::registry&, const entt::entity*, const entt::entity*, const Params&) >;
+
+  std::vector< Step > steps;
+
+  template< typename T >
+  Prefab& with(const T& value)
+  {
+    steps.push_back(
+      [value](entt::registry& r, const entt::entity* first, const entt::entity* last, const Params&)
+      {
+        r.insert< T >(first, last, value);
+      }
+    );
+    return *this;
+  }
+
+  // Runs after the components added before it, with the spawned range
+  Prefab& then(Step step)
+  {
+    steps.push_back(std::move(step));
+    return *this;
+  }
+
+  // Appends `count` new entities to `out`
+  void spawn(entt::registry& r, std::size_t count, std::vector< entt::entity >& out, const Params& params = {}) const
+  {
+    const std::size_t first = out.size();
+    out.resize(first + count);
+    r.create(out.begin() + first, out.end());
+
+    const entt::entity* begin = out.data() + first;
+    const entt::entity* end = out.data() + out.size();
+    for(const auto& step : steps)
+      step(r, begin, end, params);
+  }
+};
+
+struct PrefabLibrary
+{
+  std::unordered_map< std::string, Prefab > prefabs;
+
+  Prefab& define(const std::string& name)
+  {
+    auto& prefab = prefabs[name];
+    prefab.steps.clear();
+    return prefab;
+  }
+
+  const Prefab* find(const std::string& name) const
+  {
+    auto iter = prefabs.find(name);
+    if(iter == prefabs.end())
+      return nullptr;
+    return &iter->second;
+  }
+
+  // Returns false, spawning nothing, if no prefab has that name
+  bool spawn(const std::string& name, entt::registry& r, std::size_t count, std::vector< entt::entity >& out, const Prefab::Params& params = {}) const
+  {
+    auto prefab = find(name);
+    if(!prefab)
+      return false;
+    prefab->spawn(r, count, out, params);
+    return true;
+  }
+};
+
+}
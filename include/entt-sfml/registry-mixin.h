@@ -1,54 +1,73 @@
 #pragma once
 
+#include "animation.h"
 #include "asset-cache.h"
+#include "collision.h"
 #include "controller-manager.h"
 #include "controllers/keyboard.h"
 #include "controllers/mouse.h"
 #include "events.h"
+#include "hierarchy.h"
+#include "memory.h"
+#include "prefab.h"
+#include "render-queue.h"
+#include "snapshot.h"
+#include "tilemap.h"
+#include "world-runner.h"
+#include <stdexcept>
 
 #ifdef FOWL_ENTT_MRUBY
 # include <mruby/proc.h>
 # include <mruby/hash.h>
 # include "mruby-bindings.h"
+# include "mruby-gc.h"
+# include "mruby-scheduler.h"
+# include "mruby-views.h"
 #endif
 
 namespace UI
 {
 
 
-struct FontCache : AssetCache< sf::Font, FontCache >
+template< typename Derived >
+struct RegistryMixin
 {
-  std::unique_ptr< sf::Font > load(const std::string& file)
+  using Self = RegistryMixin< Derived >;
+  Derived& derived() { return *static_cast< Derived* >(this); }
+
+  void ui_render_drawable(RenderDrawableEvent& event)
   {
-    sf::Font font;
-    if(! font.loadFromFile(file))
-      return nullptr;
-    return std::make_unique< sf::Font >(font);
+    ui_render_queue().submit(event.sort_key, std::move(event.drawable));
   }
-};
 
-struct TextureCache : AssetCache< sf::Texture, TextureCache >
-{
-  std::unique_ptr< sf::Texture > load(const std::string& file)
+  // Drains queued RenderDrawableEvents and draws the frame's commands in
+  // sort key order
+  void ui_render()
   {
-    sf::Texture tex;
-    if(!tex.loadFromFile(file))
-      return nullptr;
-    return std::make_unique< sf::Texture >(tex);
+    auto& dispatcher = derived().template ctx< entt::dispatcher >();
+    auto window = ui_render_window();
+    if(!window)
+    {
+      dispatcher.template clear< RenderDrawableEvent >();
+      ui_render_queue().clear();
+      return;
+    }
+
+    dispatcher.template update< RenderDrawableEvent >();
+    UI::draw_tilemaps(derived(), ui_render_queue(), window->getView());
+    derived().template ctx< UI::SpriteBatcher >().submit(derived(), ui_render_queue());
+    ui_render_queue().flush(*window);
   }
-};
 
-template< typename Derived >
-struct RegistryMixin
-{
-  using Self = RegistryMixin< Derived >;
-  Derived& derived() { return *static_cast< Derived* >(this); }
+  // Without a window nothing is drawn and draw requests are dropped
+  bool ui_headless()
+  {
+    return ui_render_window() == nullptr;
+  }
 
-  void ui_render_drawable(const RenderDrawableEvent& event)
+  UI::RenderQueue& ui_render_queue()
   {
-    auto& registry = derived();
-    auto window = registry.template ctx< sf::RenderWindow* >();
-    window->draw(*event.drawable);
+    return derived().template ctx< UI::RenderQueue >();
   }
 
   UI::FontCache& ui_font_cache()
@@ -71,23 +90,213 @@ struct RegistryMixin
     return derived().template ctx< UI::ControllerManager >();
   }
 
-  void ui_init(sf::RenderWindow* window)
+  UI::PrefabLibrary& ui_prefabs()
   {
+    return derived().template ctx< UI::PrefabLibrary >();
+  }
+
+  UI::SnapshotFormat& ui_snapshot_format()
+  {
+    return derived().template ctx< UI::SnapshotFormat >();
+  }
+
+  UI::AnimationLibrary& ui_animations()
+  {
+    return derived().template ctx< UI::AnimationLibrary >();
+  }
+
+  // Advances every SpriteAnimation by `dt`
+  void ui_animate(std::chrono::milliseconds dt)
+  {
+    UI::animate_sprites(derived(), dt);
+  }
+
+  UI::UpdateScheduler& ui_update_scheduler()
+  {
+    return derived().template ctx< UI::UpdateScheduler >();
+  }
+
+  // Starts a frame for UpdateScheduler and, every `reassign_interval`
+  // frames, re-buckets scheduled entities by distance to the view center
+  void ui_schedule_updates(std::chrono::milliseconds dt, unsigned reassign_interval = 8)
+  {
+    auto& scheduler = ui_update_scheduler();
+    scheduler.begin_frame(dt);
+
+    auto window = ui_render_window();
+    if(window && reassign_interval > 0 && scheduler.frame % reassign_interval == 0)
+      scheduler.assign_by_distance(derived(), window->getView().getCenter());
+  }
+
+  UI::CollisionWorld& ui_collision_world()
+  {
+    return derived().template ctx< UI::CollisionWorld >();
+  }
+
+  void ui_update_transforms()
+  {
+    derived().template ctx< UI::TransformHierarchy >().update(derived());
+  }
+
+  // Runs the library's per-frame systems in order: update scheduling,
+  // controllers, script behaviors, sprite animation, transforms, then
+  // collision. Queued events are left for the caller's dispatcher update,
+  // and nothing is drawn, see ui_render().
+  void ui_tick(std::chrono::milliseconds dt)
+  {
+    ui_schedule_updates(dt);
+    ui_controller_manager().update(derived(), dt, ui_headless());
+#ifdef FOWL_ENTT_MRUBY
+    ui_mrb_update_behaviors(dt);
+#endif
+    ui_animate(dt);
+    ui_update_transforms();
+    ui_collision_world().update(derived());
+  }
+
+  UI::WorldMemory* ui_world_memory()
+  {
+    return derived().template ctx< UI::WorldMemory* >();
+  }
+
+  UI::SharedAssets* ui_shared_assets()
+  {
+    return derived().template ctx< UI::SharedAssets* >();
+  }
+
+  // The world's memory resource, for containers such as Tilemap that should
+  // count against its WorldMemory
+  std::pmr::memory_resource* ui_memory_resource()
+  {
+    auto memory = ui_world_memory();
+    return memory ? memory->resource() : std::pmr::get_default_resource();
+  }
+
+  // Library and pool storage broken down by component type, plus asset
+  // caches and per-frame buffers. Add user components with
+  // report.component< T >(registry, name).
+  UI::MemoryReport ui_memory_report()
+  {
+    auto& r = derived();
+    UI::MemoryReport report;
+    report
+      .template component< UI::Controller >(r, "UI::Controller")
+      .template component< UI::Relationship >(r, "UI::Relationship")
+      .template component< UI::LocalTransform >(r, "UI::LocalTransform")
+      .template component< UI::WorldTransform >(r, "UI::WorldTransform")
+      .template component< UI::Tilemap >(r, "UI::Tilemap")
+      .template component< UI::Collider >(r, "UI::Collider")
+      .template component< UI::UpdateRate >(r, "UI::UpdateRate");
+
+    std::size_t tile_bytes = 0;
+    r.template view< UI::Tilemap >().each(
+      [&](auto& map)
+      {
+        tile_bytes += map.tiles.capacity() * sizeof(std::uint32_t);
+        for(const auto& chunk : map.chunks)
+          tile_bytes += chunk.vertices.getVertexCount() * sizeof(sf::Vertex);
+      }
+    );
+    report.add("UI::Tilemap tiles", r.template size< UI::Tilemap >(), tile_bytes);
+
+    auto texture_size = [](const sf::Texture& texture)
+    {
+      auto size = texture.getSize();
+      return (std::size_t)size.x * size.y * 4;
+    };
+    // Records borrowed from the shared caches are counted below
+    std::size_t textures = 0, texture_bytes = 0, fonts = 0;
+    for(const auto& item : ui_texture_cache().cache)
+      if(item.second.asset)
+      {
+        ++textures;
+        texture_bytes += texture_size(*item.second.asset);
+      }
+    for(const auto& item : ui_font_cache().cache)
+      if(item.second.asset)
+        ++fonts;
+    report.add("TextureCache (video memory)", textures, texture_bytes);
+    report.add("FontCache", fonts, 0);
+
+    // Shared by every world using them, so also counted in their reports
+    if(auto shared = ui_shared_assets())
+    {
+      std::size_t shared_textures = 0, shared_bytes = 0;
+      shared->textures.each(
+        [&](const std::string&, const sf::Texture& texture)
+        {
+          ++shared_textures;
+          shared_bytes += texture_size(texture);
+        }
+      );
+      report.add("SharedTextureCache (video memory)", shared_textures, shared_bytes);
+      report.add("SharedFontCache", shared->fonts.size(), 0);
+    }
+
+    report.add("RenderQueue", ui_render_queue().size(), ui_render_queue().memory_usage());
+    report.add("CollisionWorld", ui_collision_world().proxies.size(), ui_collision_world().memory_usage());
+
+    if(auto memory = ui_world_memory())
+      report.add("WorldMemory (allocated)", memory->accounting.allocations, memory->accounting.used);
+    return report;
+  }
+
+  // With `memory`, the library's per-world containers allocate from it so
+  // their usage is attributed to and capped by that world. Those containers
+  // live in the registry's context and are only freed with the registry, so
+  // `memory` must outlive it; it can't be a member of the registry class,
+  // which would be destroyed first, and passing one throws
+  // std::invalid_argument. With `shared_assets`, fonts and textures come
+  // from the process-wide caches instead of being loaded per registry.
+  void ui_init(sf::RenderWindow* window, UI::WorldMemory* memory = nullptr, UI::SharedAssets* shared_assets = nullptr)
+  {
+    const char* self = reinterpret_cast< const char* >(&derived());
+    const char* where = reinterpret_cast< const char* >(memory);
+    if(memory && where >= self && where < self + sizeof(Derived))
+      throw std::invalid_argument("WorldMemory must outlive the registry, it can't be a member of it");
+
     derived().template set< sf::RenderWindow* >(window);
+    derived().template set< UI::WorldMemory* >(memory);
+    derived().template set< UI::SharedAssets* >(shared_assets);
+    std::pmr::memory_resource* resource = memory ? memory->resource() : std::pmr::get_default_resource();
 
     if(! derived().template try_ctx< entt::dispatcher >())
       derived().template set< entt::dispatcher >();
     
-    derived().template ctx< entt::dispatcher >()
-      .template sink< RenderDrawableEvent >()
-      .template connect< &Self::ui_render_drawable >(this);
-
-    derived().template set< UI::FontCache >();
-    derived().template set< UI::TextureCache >();
-    derived().template set< UI::ControllerManager >();
+    if(window)
+      derived().template ctx< entt::dispatcher >()
+        .template sink< RenderDrawableEvent >()
+        .template connect< &Self::ui_render_drawable >(this);
+
+    auto& fonts = derived().template set< UI::FontCache >(resource);
+    auto& textures = derived().template set< UI::TextureCache >(resource);
+    if(shared_assets)
+    {
+      fonts.shared = &shared_assets->fonts;
+      textures.shared = &shared_assets->textures;
+    }
+    derived().template set< UI::ControllerManager >(resource);
+    derived().template set< UI::RenderQueue >(resource);
+    derived().template set< UI::TransformHierarchy >(resource);
+    derived().template set< UI::PrefabLibrary >();
+    derived().template set< UI::AnimationLibrary >();
+    derived().template set< UI::SpriteBatcher >(resource);
+    derived().template set< UI::UpdateScheduler >();
+    auto& collision_world = derived().template set< UI::CollisionWorld >(resource);
+    UI::add_ui_snapshot_components(derived().template set< UI::SnapshotFormat >());
 
     derived().template on_destroy< UI::Controller >()
       .template connect< &UI::on_remove_controller >();
+    derived().template on_destroy< UI::Relationship >()
+      .template connect< &UI::on_remove_relationship >();
+    derived().template on_construct< UI::Collider >()
+      .template connect< &UI::CollisionWorld::on_add_collider >(&collision_world);
+  }
+
+  // Server mode: the same game code and systems, without a window
+  void ui_init_headless(UI::WorldMemory* memory = nullptr, UI::SharedAssets* shared_assets = nullptr)
+  {
+    ui_init(nullptr, memory, shared_assets);
   }
 
 #ifdef FOWL_ENTT_MRUBY
@@ -241,7 +450,7 @@ struct RegistryMixin
 
     std::shared_ptr< UI::Controllers::Controller > controller;
     if(strcmp(ctrl_type, "keyboard") == 0)
-      controller = UI::Controllers::Keyboard::create(ctrl_map);
+      controller = UI::Controllers::Keyboard::create(ctrl_map, registry->ui_controller_manager().resource);
 
     if(! controller)
       return mrb_nil_value();
@@ -254,6 +463,130 @@ struct RegistryMixin
     return mrb_str_new_cstr(mrb, ctrl_name);
   }
 
+  static mrb_value ui_mrb_registry_spawn(mrb_state* mrb, mrb_value self)
+  {
+    // Expects a prefab name, a count and an optional hash of numeric params
+    char* prefab_name;
+    mrb_int count;
+    mrb_value params_hash = mrb_nil_value();
+    if(mrb_get_args(mrb, "zi|H", &prefab_name, &count, &params_hash) < 2 || count < 0)
+      return mrb_nil_value();
+
+    Derived* registry = Derived::mrb_value_to_registry(mrb, self);
+    if(!registry)
+      return mrb_nil_value();
+    if(! registry->ui_prefabs().find(prefab_name))
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "unknown prefab %S", mrb_str_new_cstr(mrb, prefab_name));
+
+    UI::Prefab::Params params;
+    if(mrb_hash_p(params_hash))
+    {
+      mrb_hash_foreach_func* fn = [](mrb_state* mrb, mrb_value key, mrb_value value, void* ud) -> int
+      {
+        auto& params = *(UI::Prefab::Params*)ud;
+        if(mrb_symbol_p(key))
+          key = mrb_sym2str(mrb, mrb_symbol(key));
+        params[mrb_string_value_cstr(mrb, &key)] = mrb_to_flo(mrb, value);
+        return 0;
+      };
+      mrb_hash_foreach(mrb, mrb_hash_ptr(params_hash), fn, &params);
+    }
+
+    std::vector< entt::entity > entities;
+    entities.reserve(count);
+    if(! registry->ui_prefabs().spawn(prefab_name, *registry, count, entities, params))
+      return mrb_nil_value();
+
+    mrb_value result = mrb_ary_new_capa(mrb, entities.size());
+    for(auto entity : entities)
+      mrb_ary_push(mrb, result, mrb_fixnum_value((mrb_int)entity));
+    return result;
+  }
+
+  static mrb_value ui_mrb_registry_behavior(mrb_state* mrb, mrb_value self)
+  {
+    // Expects an entity, an optional priority and a block run as a fiber
+    mrb_int entity, priority = 0;
+    mrb_value block = mrb_nil_value();
+    if(mrb_get_args(mrb, "i|i&", &entity, &priority, &block) < 1 || mrb_nil_p(block))
+      return mrb_nil_value();
+
+    Derived* registry = Derived::mrb_value_to_registry(mrb, self);
+    if(!registry || ! registry->valid((entt::entity)entity))
+      return mrb_nil_value();
+
+    auto& scheduler = registry->template ctx< UI::ScriptScheduler >();
+    return mrb_fixnum_value((mrb_int)scheduler.start(mrb, (entt::entity)entity, block, priority));
+  }
+
+  static mrb_value ui_mrb_registry_stop_behavior(mrb_state* mrb, mrb_value self)
+  {
+    mrb_int id;
+    if(mrb_get_args(mrb, "i", &id) != 1 || id < 0)
+      return mrb_nil_value();
+
+    Derived* registry = Derived::mrb_value_to_registry(mrb, self);
+    if(!registry)
+      return mrb_nil_value();
+
+    registry->template ctx< UI::ScriptScheduler >().stop(mrb, id);
+    return mrb_true_value();
+  }
+
+  // Kernel#wait(seconds = 0), suspends the running behavior
+  static mrb_value ui_mrb_wait(mrb_state* mrb, mrb_value self)
+  {
+    mrb_float seconds = 0;
+    mrb_get_args(mrb, "|f", &seconds);
+    mrb_value value = mrb_float_value(mrb, seconds);
+    return mrb_fiber_yield(mrb, 1, &value);
+  }
+
+  static mrb_value ui_mrb_registry_script_stats(mrb_state* mrb, mrb_value self)
+  {
+    Derived* registry = Derived::mrb_value_to_registry(mrb, self);
+    if(!registry)
+      return mrb_nil_value();
+
+    auto gc = registry->template try_ctx< UI::ScriptGC >();
+    if(!gc)
+      return mrb_nil_value();
+
+    const auto& stats = gc->last_frame;
+    mrb_value hash = mrb_hash_new(mrb);
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "allocations"), mrb_fixnum_value(stats.allocations));
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "live_objects"), mrb_fixnum_value(stats.live_objects));
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "gc_steps"), mrb_fixnum_value(stats.steps));
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "gc_pause_us"), mrb_fixnum_value(stats.pause.count()));
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "gc_worst_pause_us"), mrb_fixnum_value(gc->worst_pause.count()));
+    mrb_hash_set(mrb, hash, mrb_str_new_lit(mrb, "gc_cycles"), mrb_fixnum_value(gc->cycles));
+    return hash;
+  }
+
+  // registry.view("Component", "field") => ComponentView over the field in
+  // every component of that pool, see ScriptViews
+  static mrb_value ui_mrb_registry_view(mrb_state* mrb, mrb_value self)
+  {
+    const char *component, *field;
+    if(mrb_get_args(mrb, "zz", &component, &field) != 2)
+      return mrb_nil_value();
+
+    Derived* registry = Derived::mrb_value_to_registry(mrb, self);
+    if(!registry)
+      return mrb_nil_value();
+
+    auto& pools = registry->ui_script_views().pools;
+    auto pool = pools.find(component);
+    if(pool == pools.end())
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "component %S is not exposed to scripts", mrb_str_new_cstr(mrb, component));
+    auto found = pool->second->fields.find(field);
+    if(found == pool->second->fields.end())
+      mrb_raisef(mrb, E_ARGUMENT_ERROR, "%S has no field %S", mrb_str_new_cstr(mrb, component), mrb_str_new_cstr(mrb, field));
+
+    entt::registry* base = registry;
+    return UI::ScriptViewMethods::wrap(mrb, new UI::ScriptView{ base, pool->second.get(), found->second });
+  }
+
   static mrb_value ui_mrb_draw(mrb_state* mrb, mrb_value self)
   {
     mrb_value hash;
@@ -261,17 +594,35 @@ struct RegistryMixin
       return mrb_nil_value();
 
     Derived* registry = Derived::mrb_value_to_registry(mrb, self);
-    if(!registry)
+    if(!registry || registry->ui_headless())
       return mrb_nil_value();
 
     auto& dispatcher = registry->template ctx< entt::dispatcher >();
 
-    std::string str;
     sf::Vector2f vfval;
     sf::Color cval;
     float fval;
     MRuby::HashReader reader(mrb, hash);
 
+    // Out of range (or NaN) values would not fit the sort key
+    std::uint8_t layer = 0;
+    std::uint16_t depth = 0;
+    if(reader.read_hash("layer", fval))
+    {
+      if(!(fval >= 0 && fval <= UINT8_MAX))
+        mrb_raisef(mrb, E_ARGUMENT_ERROR, "layer %S is outside 0..255", mrb_float_value(mrb, fval));
+      layer = (std::uint8_t)fval;
+    }
+    if(reader.read_hash("depth", fval))
+    {
+      if(!(fval >= 0 && fval <= UINT16_MAX))
+        mrb_raisef(mrb, E_ARGUMENT_ERROR, "depth %S is outside 0..65535", mrb_float_value(mrb, fval));
+      depth = (std::uint16_t)fval;
+    }
+    const std::uint64_t sort_key = UI::SortKey::make(layer, depth);
+
+    std::string str;
+
     auto set_styles = [&](auto& resource){
       if(reader.read_hash("outline_color", cval))
         resource.setOutlineColor(cval);
@@ -318,7 +669,7 @@ struct RegistryMixin
       // if(reader.read_hash("y", fval))
       //   shape->setPosition(shape->getPosition().x, fval);
 
-      dispatcher.template enqueue< UI::RenderDrawableEvent >({ std::move(shape) });
+      dispatcher.template enqueue< UI::RenderDrawableEvent >({ std::move(shape), sort_key });
       return reader.self;
     }
     if(reader.read_hash("text", str))
@@ -338,7 +689,7 @@ struct RegistryMixin
         text->setCharacterSize(fval);
 
       set_styles(*text);
-      dispatcher.template enqueue< UI::RenderDrawableEvent >({ std::move(text) });
+      dispatcher.template enqueue< UI::RenderDrawableEvent >({ std::move(text), sort_key });
       return reader.self;
     }
 
@@ -379,7 +730,18 @@ struct RegistryMixin
         .define_method("window_size", ui_mrb_registry_window_size, MRB_ARGS_REQ(0))
         .define_method("set_window_size", ui_mrb_registry_set_window_size, MRB_ARGS_REQ(2))
         .define_method("draw", ui_mrb_draw, MRB_ARGS_REQ(1))
+        .define_method("spawn", ui_mrb_registry_spawn, MRB_ARGS_REQ(2) | MRB_ARGS_OPT(1))
+        .define_method("behavior", ui_mrb_registry_behavior, MRB_ARGS_REQ(1) | MRB_ARGS_OPT(1) | MRB_ARGS_BLOCK())
+        .define_method("stop_behavior", ui_mrb_registry_stop_behavior, MRB_ARGS_REQ(1))
+        .define_method("script_stats", ui_mrb_registry_script_stats, MRB_ARGS_REQ(0))
+        .define_method("view", ui_mrb_registry_view, MRB_ARGS_REQ(2))
       ;
+      UI::ScriptViewMethods::define(state);
+      mrb_define_method(state, state->kernel_module, "wait", ui_mrb_wait, MRB_ARGS_OPT(1));
+
+      derived().template set< UI::ScriptScheduler >();
+      derived().template set< UI::ScriptGC >();
+      derived().template set< UI::ScriptViews >();
 
       auto& dispatcher = derived().template ctx< entt::dispatcher >();
       dispatcher
@@ -388,7 +750,35 @@ struct RegistryMixin
     }
   }
 
-  void ui_mrb_cleanup() const
+  // Components registered here can be read and written in bulk by scripts
+  // through registry.view, see ScriptViews
+  UI::ScriptViews& ui_script_views()
+  {
+    return derived().template ctx< UI::ScriptViews >();
+  }
+
+  // Resumes due script behaviors within the scheduler's time budget
+  void ui_mrb_update_behaviors(std::chrono::milliseconds dt)
+  {
+    auto scheduler = derived().template try_ctx< UI::ScriptScheduler >();
+    if(!scheduler)
+      return;
+
+    mrb_state* mrb = derived().template ctx< mrb_state* >();
+    scheduler->update(mrb, derived(), mrb_gv_get(mrb, mrb_intern_lit(mrb, "$registry")), dt);
+  }
+
+  // Runs the script garbage collector for at most its time budget; call once
+  // per frame where a pause hurts least, e.g. right after display(). The
+  // first call turns off mruby's automatic GC, so keep calling it.
+  void ui_mrb_collect_garbage()
+  {
+    auto gc = derived().template try_ctx< UI::ScriptGC >();
+    if(gc)
+      gc->step(derived().template ctx< mrb_state* >());
+  }
+
+  void ui_mrb_cleanup()
   {
     // Doesn't really matter since the mrb_state* gets deleted anyways
     mrb_state* mrb = derived().mrb;
@@ -400,6 +790,11 @@ struct RegistryMixin
         mrb_gc_unregister(mrb, mrb_obj_value(proc));
       }
     }
+
+    if(auto scheduler = derived().template try_ctx< UI::ScriptScheduler >())
+      scheduler->clear(mrb);
+    if(auto gc = derived().template try_ctx< UI::ScriptGC >())
+      gc->detach(mrb);
   }
 
 #endif
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace UI
+{
+
+// Draw commands are ordered by a 64-bit key, compared as an unsigned integer.
+// From most to least significant:
+//   layer (8 bits) | depth (16 bits) | blend mode (8 bits) | material (32 bits)
+// Keeping blend and material below depth means commands on the same layer and
+// depth end up adjacent when they share a texture, so they can be batched.
+struct SortKey
+{
+  static constexpr int layer_shift = 56;
+  static constexpr int depth_shift = 40;
+  static constexpr int blend_shift = 32;
+
+  static std::uint64_t make(std::uint8_t layer, std::uint16_t depth, std::uint8_t blend = 0, std::uint32_t material = 0)
+  {
+    return ((std::uint64_t)layer << layer_shift)
+      | ((std::uint64_t)depth << depth_shift)
+      | ((std::uint64_t)blend << blend_shift)
+      | (std::uint64_t)material;
+  }
+
+  static std::uint64_t make(std::uint8_t layer, std::uint16_t depth, const sf::BlendMode& blend, const sf::Texture* texture)
+  {
+    return make(layer, depth, blend_id(blend), material_id(texture));
+  }
+
+  static std::uint8_t layer(std::uint64_t key) { return (key >> layer_shift) & 0xFF; }
+  static std::uint16_t depth(std::uint64_t key) { return (key >> depth_shift) & 0xFFFF; }
+
+  static std::uint8_t blend_id(const sf::BlendMode& blend)
+  {
+    if(blend == sf::BlendAlpha)
+      return 0;
+    if(blend == sf::BlendAdd)
+      return 1;
+    if(blend == sf::BlendMultiply)
+      return 2;
+    if(blend == sf::BlendNone)
+      return 3;
+    return 0xFF;
+  }
+
+  static std::uint32_t material_id(const sf::Texture* texture)
+  {
+    return texture ? texture->getNativeHandle() : 0;
+  }
+};
+
+struct RenderCommand
+{
+  std::uint64_t key;
+  // Either a drawable, or a range of pre-transformed triangles in the
+  // queue's vertex buffer (drawable == nullptr)
+  const sf::Drawable* drawable;
+  sf::RenderStates states;
+  std::size_t first_vertex, vertex_count;
+};
+
+// Collects a frame's draw commands, sorts them by key with a stable LSD radix
+// sort (linear in the number of commands) and submits them, merging adjacent
+// vertex commands that share a texture and blend mode into one draw call.
+struct RenderQueue
+{
+  struct SortEntry
+  {
+    std::uint64_t key;
+    std::uint32_t index;
+  };
+
+  std::pmr::vector< RenderCommand > commands;
+  std::pmr::vector< std::unique_ptr< sf::Drawable > > owned;
+  std::pmr::vector< sf::Vertex > vertices;
+  std::pmr::vector< sf::Vertex > batch;
+  std::pmr::vector< SortEntry > order, scratch;
+
+  // Number of draw calls issued by the last flush()
+  std::size_t draw_calls = 0;
+
+  RenderQueue(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : commands(resource), owned(resource), vertices(resource), batch(resource),
+    order(resource), scratch(resource)
+  {
+  }
+
+  std::size_t memory_usage() const
+  {
+    return commands.capacity() * sizeof(RenderCommand)
+      + owned.capacity() * sizeof(std::unique_ptr< sf::Drawable >)
+      + (vertices.capacity() + batch.capacity()) * sizeof(sf::Vertex)
+      + (order.capacity() + scratch.capacity()) * sizeof(SortEntry);
+  }
+
+  // The drawable must outlive the next flush()
+  void submit(std::uint64_t key, const sf::Drawable& drawable, const sf::RenderStates& states = sf::RenderStates::Default)
+  {
+    commands.push_back({ key, &drawable, states, 0, 0 });
+  }
+
+  void submit(std::uint64_t key, std::unique_ptr< sf::Drawable >&& drawable, const sf::RenderStates& states = sf::RenderStates::Default)
+  {
+    if(!drawable)
+      return;
+    submit(key, *drawable, states);
+    owned.push_back(std::move(drawable));
+  }
+
+  // Reserves `count` vertices (a triangle list) and returns them to be filled
+  // in by the caller. The pointer is only valid until the next submission.
+  sf::Vertex* submit_vertices(std::uint64_t key, std::size_t count, const sf::Texture* texture, const sf::BlendMode& blend = sf::BlendAlpha)
+  {
+    sf::RenderStates states(blend);
+    states.texture = texture;
+    std::size_t first = vertices.size();
+    vertices.resize(first + count);
+    commands.push_back({ key, nullptr, states, first, count });
+    return vertices.data() + first;
+  }
+
+  void submit_vertices(std::uint64_t key, const sf::Vertex* source, std::size_t count, const sf::Texture* texture, const sf::BlendMode& blend = sf::BlendAlpha, const sf::Transform& transform = sf::Transform::Identity)
+  {
+    sf::Vertex* dest = submit_vertices(key, count, texture, blend);
+    if(transform == sf::Transform::Identity)
+    {
+      std::copy(source, source + count, dest);
+      return;
+    }
+    for(std::size_t i = 0; i < count; ++i)
+    {
+      dest[i] = source[i];
+      dest[i].position = transform.transformPoint(source[i].position);
+    }
+  }
+
+  std::size_t size() const
+  {
+    return commands.size();
+  }
+
+  void sort()
+  {
+    const std::size_t n = commands.size();
+    order.resize(n);
+    scratch.resize(n);
+    if(n == 0)
+      return;
+
+    // Histogram all eight digits in one pass over the keys
+    std::array< std::array< std::uint32_t, 256 >, 8 > counts{};
+    for(std::size_t i = 0; i < n; ++i)
+    {
+      const std::uint64_t key = commands[i].key;
+      order[i] = { key, (std::uint32_t)i };
+      for(int digit = 0; digit < 8; ++digit)
+        ++counts[digit][(key >> (digit * 8)) & 0xFF];
+    }
+
+    for(int digit = 0; digit < 8; ++digit)
+    {
+      const int shift = digit * 8;
+      auto& count = counts[digit];
+
+      // Every key has the same value for this digit, nothing to reorder
+      if(count[(order[0].key >> shift) & 0xFF] == n)
+        continue;
+
+      std::uint32_t offset = 0;
+      for(auto& c : count)
+      {
+        std::uint32_t bucket = c;
+        c = offset;
+        offset += bucket;
+      }
+
+      for(const auto& entry : order)
+        scratch[count[(entry.key >> shift) & 0xFF]++] = entry;
+      order.swap(scratch);
+    }
+  }
+
+  // With the commands sorted, one past the last command that can be drawn
+  // in the same call as the vertex command order[i]: the following vertex
+  // commands that share its texture and blend mode
+  std::size_t batch_end(std::size_t i) const
+  {
+    const RenderCommand& cmd = commands[order[i].index];
+    std::size_t end = i + 1;
+    while(end < order.size())
+    {
+      const RenderCommand& next = commands[order[end].index];
+      if(next.drawable
+        || next.states.texture != cmd.states.texture
+        || !(next.states.blendMode == cmd.states.blendMode))
+        break;
+      ++end;
+    }
+    return end;
+  }
+
+  void flush(sf::RenderTarget& target)
+  {
+    sort();
+    draw_calls = 0;
+
+    const std::size_t n = order.size();
+    for(std::size_t i = 0; i < n; )
+    {
+      const RenderCommand& cmd = commands[order[i].index];
+      if(cmd.drawable)
+      {
+        target.draw(*cmd.drawable, cmd.states);
+        ++draw_calls;
+        ++i;
+        continue;
+      }
+
+      const std::size_t end = batch_end(i);
+      if(end == i + 1)
+        target.draw(vertices.data() + cmd.first_vertex, cmd.vertex_count, sf::Triangles, cmd.states);
+      else
+      {
+        batch.clear();
+        for(std::size_t j = i; j < end; ++j)
+        {
+          const RenderCommand& merged = commands[order[j].index];
+          batch.insert(batch.end(),
+            vertices.begin() + merged.first_vertex,
+            vertices.begin() + merged.first_vertex + merged.vertex_count);
+        }
+        target.draw(batch.data(), batch.size(), sf::Triangles, cmd.states);
+      }
+      ++draw_calls;
+      i = end;
+    }
+
+    clear();
+  }
+
+  void clear()
+  {
+    commands.clear();
+    owned.clear();
+    vertices.clear();
+  }
+};
+
+} // ::UI
@@ -0,0 +1,693 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+# define FOWL_ENTT_LOCAL_SOCKET
+#endif
+
+namespace UI
+{
+
+struct BitWriter
+{
+  std::vector< std::uint8_t > bytes;
+  std::uint64_t pending = 0;
+  unsigned pending_bits = 0;
+
+  // Writes the low `bits` bits of value, bits <= 32
+  void write(std::uint32_t value, unsigned bits)
+  {
+    if(bits < 32)
+      value &= (1u << bits) - 1;
+    pending |= (std::uint64_t)value << pending_bits;
+    pending_bits += bits;
+    while(pending_bits >= 8)
+    {
+      bytes.push_back(pending & 0xFF);
+      pending >>= 8;
+      pending_bits -= 8;
+    }
+  }
+
+  void write_varint(std::uint32_t value)
+  {
+    while(value >= 0x80)
+    {
+      write((value & 0x7F) | 0x80, 8);
+      value >>= 7;
+    }
+    write(value, 8);
+  }
+
+  const std::vector< std::uint8_t >& finish()
+  {
+    if(pending_bits > 0)
+      bytes.push_back(pending & 0xFF);
+    pending = 0;
+    pending_bits = 0;
+    return bytes;
+  }
+
+  void clear()
+  {
+    bytes.clear();
+    pending = 0;
+    pending_bits = 0;
+  }
+};
+
+struct BitReader
+{
+  const std::uint8_t* data;
+  std::size_t size;
+  std::size_t position = 0;
+
+  bool read(std::uint32_t& value, unsigned bits)
+  {
+    if(position + bits > size * 8)
+      return false;
+    value = 0;
+    for(unsigned i = 0; i < bits; )
+    {
+      const std::size_t byte = (position + i) / 8;
+      const unsigned offset = (position + i) % 8;
+      const unsigned take = std::min(8 - offset, bits - i);
+      value |= (std::uint32_t)((data[byte] >> offset) & ((1u << take) - 1)) << i;
+      i += take;
+    }
+    position += bits;
+    return true;
+  }
+
+  bool read_varint(std::uint32_t& value)
+  {
+    value = 0;
+    for(unsigned shift = 0; shift < 35; shift += 7)
+    {
+      std::uint32_t byte;
+      if(!read(byte, 8))
+        return false;
+      value |= (byte & 0x7F) << shift;
+      if(!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+};
+
+// Components are compared as 32-bit words. Each word is sent as one bit if
+// unchanged, otherwise as its XOR with the baseline with leading zeros
+// stripped, which is small for the slowly changing floats and counters that
+// make up most components.
+namespace Delta
+{
+  template< typename T >
+  constexpr std::size_t words = (sizeof(T) + 3) / 4;
+
+  template< typename T >
+  void to_words(const T& value, std::uint32_t* out)
+  {
+    std::memset(out, 0, words< T > * 4);
+    std::memcpy(out, &value, sizeof(T));
+  }
+
+  template< typename T >
+  void encode(BitWriter& w, const T& baseline, const T& value)
+  {
+    std::uint32_t old_words[words< T >], new_words[words< T >];
+    to_words(baseline, old_words);
+    to_words(value, new_words);
+    for(std::size_t i = 0; i < words< T >; ++i)
+    {
+      std::uint32_t x = old_words[i] ^ new_words[i];
+      if(x == 0)
+      {
+        w.write(0, 1);
+        continue;
+      }
+      unsigned bits = 32;
+      while(!(x >> (bits - 1)))
+        --bits;
+      w.write(1, 1);
+      w.write(bits - 1, 5);
+      w.write(x, bits);
+    }
+  }
+
+  template< typename T >
+  bool decode(BitReader& r, const T& baseline, T& value)
+  {
+    std::uint32_t value_words[words< T >];
+    to_words(baseline, value_words);
+    for(std::size_t i = 0; i < words< T >; ++i)
+    {
+      std::uint32_t changed, bits, x;
+      if(!r.read(changed, 1))
+        return false;
+      if(!changed)
+        continue;
+      if(!r.read(bits, 5) || !r.read(x, bits + 1))
+        return false;
+      value_words[i] ^= x;
+    }
+    std::memcpy(&value, value_words, sizeof(T));
+    return true;
+  }
+
+  template< typename T >
+  T zero()
+  {
+    T value;
+    std::memset(&value, 0, sizeof(T));
+    return value;
+  }
+}
+
+// Packet layout, bit packed:
+//   varint sequence
+//   records: 2-bit kind | varint entity | (8-bit component | delta)
+//   a record of kind end_record closes the packet
+namespace Replication
+{
+  constexpr std::uint32_t end_record = 0;
+  constexpr std::uint32_t update_record = 1;
+  constexpr std::uint32_t remove_record = 2;
+  constexpr std::uint32_t destroy_record = 3;
+}
+
+// Sending side. Changes are picked up from the registry's construct/update/
+// destroy signals, so components must be changed through replace() or
+// patch() to be replicated. Each packet only covers what changed since the
+// last one, delta encoded against the values last sent. The transport is a
+// reliable ordered stream, so everything sent is what the mirror has
+// acknowledged or will; acks only bound the number of packets in flight.
+struct Replicator
+{
+  struct Component
+  {
+    // Writes an update record if the value differs from its baseline
+    std::function< void(entt::registry&, entt::entity, std::uint8_t, BitWriter&) > encode;
+    std::function< void(entt::entity) > forget;
+    // Drops every baseline and marks every current value dirty
+    std::function< void(entt::registry&) > reset;
+  };
+
+  std::vector< Component > components;
+  std::unordered_map< ENTT_ID_TYPE, std::uint8_t > indices;
+  // Pending changes, deduplicated as they arrive so a stalled observer
+  // costs at most one entry per changed component
+  std::unordered_set< std::uint64_t > dirty, removed;
+  std::vector< std::uint64_t > batch;
+
+  std::uint32_t sequence = 0;
+  std::uint32_t acked = 0;
+  std::uint32_t window = 16;
+
+  static std::uint64_t change_key(entt::entity entity, std::uint8_t component)
+  {
+    return (std::uint64_t)entt::to_integral(entity) << 8 | component;
+  }
+
+  template< typename T >
+  void on_change(entt::registry&, entt::entity entity)
+  {
+    dirty.insert(change_key(entity, indices[entt::type_info< T >::id()]));
+  }
+
+  template< typename T >
+  void on_remove(entt::registry&, entt::entity entity)
+  {
+    removed.insert(change_key(entity, indices[entt::type_info< T >::id()]));
+  }
+
+  // Both sides must replicate the same types in the same order. The
+  // registry's signals point at this object, so it must not move afterwards.
+  template< typename T >
+  Replicator& replicate(entt::registry& r)
+  {
+    static_assert(std::is_trivially_copyable< T >::value, "only trivially copyable components can be replicated");
+    indices[entt::type_info< T >::id()] = components.size();
+
+    auto baselines = std::make_shared< std::unordered_map< entt::entity, T > >();
+    components.push_back({
+      [baselines](entt::registry& r, entt::entity entity, std::uint8_t component, BitWriter& w)
+      {
+        auto current = r.try_get< T >(entity);
+        if(!current)
+          return;
+        auto iter = baselines->find(entity);
+        if(iter == baselines->end())
+          iter = baselines->insert({ entity, Delta::zero< T >() }).first;
+        else if(std::memcmp(&iter->second, current, sizeof(T)) == 0)
+          return;
+        w.write(Replication::update_record, 2);
+        w.write_varint(entt::to_integral(entity));
+        w.write(component, 8);
+        Delta::encode(w, iter->second, *current);
+        iter->second = *current;
+      },
+      [baselines](entt::entity entity)
+      {
+        baselines->erase(entity);
+      },
+      [this, baselines, index = components.size()](entt::registry& r)
+      {
+        baselines->clear();
+        r.view< T >().each(
+          [&](auto entity, auto&)
+          {
+            dirty.insert(change_key(entity, index));
+          }
+        );
+      }
+    });
+
+    r.on_construct< T >().template connect< &Replicator::on_change< T > >(this);
+    r.on_update< T >().template connect< &Replicator::on_change< T > >(this);
+    r.on_destroy< T >().template connect< &Replicator::on_remove< T > >(this);
+    return *this;
+  }
+
+  // Starts over for a new observer: the next packet carries every
+  // replicated component in full
+  void reset(entt::registry& r)
+  {
+    dirty.clear();
+    removed.clear();
+    sequence = acked = 0;
+    for(auto& component : components)
+      component.reset(r);
+  }
+
+  bool can_send() const
+  {
+    return sequence - acked < window;
+  }
+
+  void acknowledge(std::uint32_t seq)
+  {
+    if(seq > acked && seq <= sequence)
+      acked = seq;
+  }
+
+  // Encodes the changes since the last packet. Returns false, keeping the
+  // changes for later, if nothing changed or too many packets are unacked.
+  bool encode(entt::registry& r, BitWriter& w)
+  {
+    if(! can_send() || (dirty.empty() && removed.empty()))
+      return false;
+
+    w.clear();
+    w.write_varint(++sequence);
+
+    // Sorted so an entity's records are adjacent
+    batch.assign(removed.begin(), removed.end());
+    std::sort(batch.begin(), batch.end());
+    entt::entity last_destroyed = entt::null;
+    for(auto key : batch)
+    {
+      const auto entity = entt::entity(key >> 8);
+      const std::uint8_t component = key & 0xFF;
+      components[component].forget(entity);
+      if(! r.valid(entity))
+      {
+        if(entity == last_destroyed)
+          continue;
+        last_destroyed = entity;
+        w.write(Replication::destroy_record, 2);
+        w.write_varint(entt::to_integral(entity));
+        continue;
+      }
+      w.write(Replication::remove_record, 2);
+      w.write_varint(entt::to_integral(entity));
+      w.write(component, 8);
+    }
+    removed.clear();
+
+    batch.assign(dirty.begin(), dirty.end());
+    std::sort(batch.begin(), batch.end());
+    for(auto key : batch)
+    {
+      const auto entity = entt::entity(key >> 8);
+      const std::uint8_t component = key & 0xFF;
+      if(r.valid(entity))
+        components[component].encode(r, entity, component, w);
+    }
+    dirty.clear();
+
+    w.write(Replication::end_record, 2);
+    w.finish();
+    return true;
+  }
+};
+
+// Receiving side, applies packets to a mirror registry
+struct ReplicationMirror
+{
+  struct Component
+  {
+    std::function< bool(entt::registry&, std::uint32_t, entt::entity, BitReader&) > apply;
+    std::function< void(entt::registry&, std::uint32_t, entt::entity) > remove;
+  };
+
+  std::vector< Component > components;
+  std::unordered_map< std::uint32_t, entt::entity > entities;
+  std::uint32_t sequence = 0;
+
+  template< typename T >
+  ReplicationMirror& replicate()
+  {
+    static_assert(std::is_trivially_copyable< T >::value, "only trivially copyable components can be replicated");
+
+    auto baselines = std::make_shared< std::unordered_map< std::uint32_t, T > >();
+    components.push_back({
+      [baselines](entt::registry& r, std::uint32_t remote, entt::entity local, BitReader& reader)
+      {
+        auto iter = baselines->find(remote);
+        if(iter == baselines->end())
+          iter = baselines->insert({ remote, Delta::zero< T >() }).first;
+        T value;
+        if(! Delta::decode(reader, iter->second, value))
+          return false;
+        iter->second = value;
+        r.emplace_or_replace< T >(local, value);
+        return true;
+      },
+      [baselines](entt::registry& r, std::uint32_t remote, entt::entity local)
+      {
+        baselines->erase(remote);
+        if(local != entt::null)
+          r.remove_if_exists< T >(local);
+      }
+    });
+    return *this;
+  }
+
+  entt::entity local_entity(entt::registry& r, std::uint32_t remote)
+  {
+    auto iter = entities.find(remote);
+    if(iter != entities.end())
+      return iter->second;
+    auto entity = r.create();
+    entities[remote] = entity;
+    return entity;
+  }
+
+  // Returns false on a malformed packet
+  bool apply(entt::registry& r, const std::uint8_t* data, std::size_t size)
+  {
+    BitReader reader{ data, size };
+    if(! reader.read_varint(sequence))
+      return false;
+
+    while(true)
+    {
+      std::uint32_t kind, remote, component;
+      if(! reader.read(kind, 2))
+        return false;
+      if(kind == Replication::end_record)
+        return true;
+      if(! reader.read_varint(remote))
+        return false;
+
+      if(kind == Replication::destroy_record)
+      {
+        auto iter = entities.find(remote);
+        entt::entity local = iter == entities.end() ? entt::null : iter->second;
+        for(auto& c : components)
+          c.remove(r, remote, entt::null);
+        if(local != entt::null)
+        {
+          if(r.valid(local))
+            r.destroy(local);
+          entities.erase(iter);
+        }
+        continue;
+      }
+
+      if(! reader.read(component, 8) || component >= components.size())
+        return false;
+
+      if(kind == Replication::remove_record)
+      {
+        auto iter = entities.find(remote);
+        components[component].remove(r, remote, iter == entities.end() ? entt::null : iter->second);
+        continue;
+      }
+
+      if(! components[component].apply(r, remote, local_entity(r, remote), reader))
+        return false;
+    }
+  }
+};
+
+#ifdef FOWL_ENTT_LOCAL_SOCKET
+
+// Length-prefixed packets over a UNIX stream socket. Neither sending nor
+// receiving blocks: what the socket can't take yet waits in the outbox.
+struct LocalSocket
+{
+  int fd = -1;
+  std::vector< std::uint8_t > inbox;
+  std::vector< std::uint8_t > outbox;
+  std::size_t outbox_sent = 0;
+
+  explicit LocalSocket(int fd = -1)
+  : fd(fd)
+  {
+  }
+
+  LocalSocket(LocalSocket&& other)
+  : fd(other.fd), inbox(std::move(other.inbox)), outbox(std::move(other.outbox)), outbox_sent(other.outbox_sent)
+  {
+    other.fd = -1;
+  }
+
+  LocalSocket& operator= (LocalSocket&& other)
+  {
+    close();
+    fd = other.fd;
+    inbox = std::move(other.inbox);
+    outbox = std::move(other.outbox);
+    outbox_sent = other.outbox_sent;
+    other.fd = -1;
+    return *this;
+  }
+
+  ~LocalSocket()
+  {
+    close();
+  }
+
+  void close()
+  {
+    if(fd >= 0)
+      ::close(fd);
+    fd = -1;
+    // Packets already received can still be read
+    outbox.clear();
+    outbox_sent = 0;
+  }
+
+  bool is_open() const
+  {
+    return fd >= 0;
+  }
+
+  // A connected pair in this process, for tests and in-process observers
+  static std::pair< LocalSocket, LocalSocket > pair()
+  {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      return { LocalSocket(), LocalSocket() };
+    return { LocalSocket(fds[0]), LocalSocket(fds[1]) };
+  }
+
+  static bool make_address(const std::string& path, sockaddr_un& address)
+  {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path))
+      return false;
+    std::strcpy(address.sun_path, path.c_str());
+    return true;
+  }
+
+  static LocalSocket listen(const std::string& path)
+  {
+    sockaddr_un address;
+    if(! make_address(path, address))
+      return LocalSocket();
+    LocalSocket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    ::unlink(path.c_str());
+    if(! socket.is_open()
+      || ::bind(socket.fd, (sockaddr*)&address, sizeof(address)) != 0
+      || ::listen(socket.fd, 1) != 0)
+      socket.close();
+    return socket;
+  }
+
+  static LocalSocket connect(const std::string& path)
+  {
+    sockaddr_un address;
+    if(! make_address(path, address))
+      return LocalSocket();
+    LocalSocket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if(socket.is_open() && ::connect(socket.fd, (sockaddr*)&address, sizeof(address)) != 0)
+      socket.close();
+    return socket;
+  }
+
+  LocalSocket accept()
+  {
+    return LocalSocket(::accept(fd, nullptr, nullptr));
+  }
+
+  // Queues a packet and sends as much of the outbox as the socket takes.
+  // Returns false if the connection failed.
+  bool send(const std::uint8_t* data, std::uint32_t size)
+  {
+    if(! is_open())
+      return false;
+    const std::uint8_t* length = reinterpret_cast< const std::uint8_t* >(&size);
+    outbox.insert(outbox.end(), length, length + sizeof(size));
+    outbox.insert(outbox.end(), data, data + size);
+    return flush();
+  }
+
+  bool flush()
+  {
+    while(is_open() && outbox_sent < outbox.size())
+    {
+      ssize_t sent = ::send(fd, outbox.data() + outbox_sent, outbox.size() - outbox_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if(sent > 0)
+      {
+        outbox_sent += sent;
+        continue;
+      }
+      if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        break;
+      close();
+      return false;
+    }
+    if(outbox_sent == outbox.size())
+    {
+      outbox.clear();
+      outbox_sent = 0;
+    }
+    return is_open();
+  }
+
+  // Bytes queued but not yet taken by the socket
+  std::size_t pending() const
+  {
+    return outbox.size() - outbox_sent;
+  }
+
+  // Non-blocking, returns true with one complete packet if one has arrived
+  bool receive(std::vector< std::uint8_t >& packet)
+  {
+    std::uint8_t buffer[4096];
+    while(is_open())
+    {
+      ssize_t got = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if(got == 0)
+        close();
+      if(got <= 0)
+        break;
+      inbox.insert(inbox.end(), buffer, buffer + got);
+    }
+
+    std::uint32_t size;
+    if(inbox.size() < sizeof(size))
+      return false;
+    std::memcpy(&size, inbox.data(), sizeof(size));
+    if(inbox.size() < sizeof(size) + size)
+      return false;
+    packet.assign(inbox.begin() + sizeof(size), inbox.begin() + sizeof(size) + size);
+    inbox.erase(inbox.begin(), inbox.begin() + sizeof(size) + size);
+    return true;
+  }
+};
+
+// Sends a packet per frame when something changed and reads back acks.
+// When the connection drops the replicator is reset, so the next socket
+// assigned starts from a full update.
+struct ReplicationServer
+{
+  Replicator replicator;
+  LocalSocket socket;
+  BitWriter writer;
+  std::vector< std::uint8_t > ack;
+  // No new packet is encoded while this many bytes are still unsent
+  std::size_t max_pending = 256 * 1024;
+  bool connected = false;
+
+  void update(entt::registry& r)
+  {
+    if(! socket.is_open())
+    {
+      if(connected)
+        replicator.reset(r);
+      connected = false;
+      return;
+    }
+    connected = true;
+
+    socket.flush();
+    while(socket.receive(ack))
+    {
+      std::uint32_t seq;
+      if(ack.size() == sizeof(seq))
+      {
+        std::memcpy(&seq, ack.data(), sizeof(seq));
+        replicator.acknowledge(seq);
+      }
+    }
+
+    if(socket.is_open() && socket.pending() < max_pending && replicator.encode(r, writer))
+      socket.send(writer.bytes.data(), writer.bytes.size());
+    if(! socket.is_open())
+    {
+      replicator.reset(r);
+      connected = false;
+    }
+  }
+};
+
+// Applies every packet that has arrived and acknowledges it
+struct ReplicationClient
+{
+  ReplicationMirror mirror;
+  LocalSocket socket;
+  std::vector< std::uint8_t > packet;
+
+  bool update(entt::registry& r)
+  {
+    while(socket.receive(packet))
+    {
+      if(! mirror.apply(r, packet.data(), packet.size()))
+        return false;
+      const std::uint32_t seq = mirror.sequence;
+      socket.send(reinterpret_cast< const std::uint8_t* >(&seq), sizeof(seq));
+    }
+    return true;
+  }
+};
+
+#endif
+
+} // ::UI
@@ -0,0 +1,527 @@
+#pragma once
+
+#include "controller-manager.h"
+#include "hierarchy.h"
+#include "memory.h"
+#include "tilemap.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace UI
+{
+
+// Binary registry snapshots. The stream is a header followed by sections:
+//   header:  u32 magic | u32 version
+//   section: u32 type | u32 count | u32 byte size | payload
+// Entities are numbered 0..n-1 in the order they were written; component
+// sections hold `count` entity numbers followed by the component data.
+// Strings (controller names, asset paths) are interned into string sections
+// and referenced by index. A section of type 0 ends the stream. Values are
+// stored in host byte order.
+namespace Snapshot
+{
+  constexpr std::uint32_t magic = 0x504E5345; // "ESNP"
+  constexpr std::uint32_t version = 1;
+
+  constexpr std::uint32_t end_section = 0;
+  constexpr std::uint32_t string_section = 1;
+  constexpr std::uint32_t entity_section = 2;
+
+  constexpr std::uint32_t null_index = 0xFFFFFFFF;
+}
+
+struct SnapshotWriter
+{
+  std::vector< char > buffer;
+  std::unordered_map< entt::entity, std::uint32_t > indices;
+  std::unordered_map< std::string, std::uint32_t > string_ids;
+  std::vector< std::string > pending_strings;
+
+  void write_bytes(const void* data, std::size_t size)
+  {
+    const char* bytes = static_cast< const char* >(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+  }
+
+  template< typename T >
+  void write(const T& value)
+  {
+    static_assert(std::is_trivially_copyable< T >::value, "write() needs a trivially copyable type");
+    write_bytes(&value, sizeof(T));
+  }
+
+  void write_string(const std::string& str)
+  {
+    auto iter = string_ids.find(str);
+    if(iter == string_ids.end())
+    {
+      iter = string_ids.insert({ str, (std::uint32_t)string_ids.size() }).first;
+      pending_strings.push_back(str);
+    }
+    write(iter->second);
+  }
+
+  // Entities outside the snapshot are written as Snapshot::null_index
+  void write_entity(entt::entity entity)
+  {
+    auto iter = indices.find(entity);
+    write(iter == indices.end() ? Snapshot::null_index : iter->second);
+  }
+};
+
+struct SnapshotReader
+{
+  const char* data;
+  std::size_t size;
+  std::size_t offset = 0;
+  const std::vector< std::string >& strings;
+  const std::vector< entt::entity >& entities;
+
+  bool read_bytes(void* output, std::size_t count)
+  {
+    if(offset + count > size)
+      return false;
+    std::memcpy(output, data + offset, count);
+    offset += count;
+    return true;
+  }
+
+  template< typename T >
+  bool read(T& value)
+  {
+    static_assert(std::is_trivially_copyable< T >::value, "read() needs a trivially copyable type");
+    return read_bytes(&value, sizeof(T));
+  }
+
+  bool read_string(std::string& str)
+  {
+    std::uint32_t id;
+    if(!read(id) || id >= strings.size())
+      return false;
+    str = strings[id];
+    return true;
+  }
+
+  bool read_entity(entt::entity& entity)
+  {
+    std::uint32_t index;
+    if(!read(index))
+      return false;
+    entity = index < entities.size() ? entities[index] : entt::null;
+    return true;
+  }
+};
+
+// The set of component types a snapshot stores, keyed by a hashed type name
+struct SnapshotFormat
+{
+  struct Component
+  {
+    std::uint32_t id;
+    std::function< void(entt::registry&, std::vector< entt::entity >&) > collect;
+    std::function< bool(entt::registry&, entt::entity) > contains;
+    std::function< void(entt::registry&, SnapshotWriter&, const std::vector< entt::entity >&, std::size_t, std::size_t) > save;
+    std::function< bool(entt::registry&, SnapshotReader&, const std::vector< entt::entity >&) > load;
+  };
+
+  std::vector< Component > components;
+
+  // Trivially copyable components are written as one block and bulk inserted
+  template< typename T >
+  SnapshotFormat& component(const char* name)
+  {
+    static_assert(std::is_trivially_copyable< T >::value, "use the save/load overload for this component");
+    components.push_back({
+      entt::hashed_string{ name }.value(),
+      [](entt::registry& r, std::vector< entt::entity >& out)
+      {
+        auto view = r.view< T >();
+        out.assign(view.begin(), view.end());
+      },
+      [](entt::registry& r, entt::entity entity)
+      {
+        return r.valid(entity) && r.has< T >(entity);
+      },
+      [](entt::registry& r, SnapshotWriter& w, const std::vector< entt::entity >& entities, std::size_t first, std::size_t last)
+      {
+        for(std::size_t i = first; i < last; ++i)
+          w.write(r.get< T >(entities[i]));
+      },
+      [](entt::registry& r, SnapshotReader& reader, const std::vector< entt::entity >& entities)
+      {
+        std::vector< T > values(entities.size());
+        if(!reader.read_bytes(values.data(), values.size() * sizeof(T)))
+          return false;
+        r.insert< T >(entities.begin(), entities.end(), values.begin(), values.end());
+        return true;
+      }
+    });
+    return *this;
+  }
+
+  // save(registry, writer, entity) / load(registry, reader, entity) -> bool
+  template< typename T, typename Save, typename Load >
+  SnapshotFormat& component(const char* name, Save save, Load load)
+  {
+    components.push_back({
+      entt::hashed_string{ name }.value(),
+      [](entt::registry& r, std::vector< entt::entity >& out)
+      {
+        auto view = r.view< T >();
+        out.assign(view.begin(), view.end());
+      },
+      [](entt::registry& r, entt::entity entity)
+      {
+        return r.valid(entity) && r.has< T >(entity);
+      },
+      [save](entt::registry& r, SnapshotWriter& w, const std::vector< entt::entity >& entities, std::size_t first, std::size_t last)
+      {
+        for(std::size_t i = first; i < last; ++i)
+          save(r, w, entities[i]);
+      },
+      [load](entt::registry& r, SnapshotReader& reader, const std::vector< entt::entity >& entities)
+      {
+        for(auto entity : entities)
+          if(!load(r, reader, entity))
+            return false;
+        return true;
+      }
+    });
+    return *this;
+  }
+
+  const Component* find(std::uint32_t id) const
+  {
+    for(const auto& component : components)
+      if(component.id == id)
+        return &component;
+    return nullptr;
+  }
+};
+
+// Writes a registry a block of entities at a time so saving can be spread
+// over several frames. Entities created after begin() are not included;
+// entities destroyed, or components removed, between steps are skipped.
+struct SnapshotSaver
+{
+  std::ostream& out;
+  const SnapshotFormat& format;
+  std::size_t block_size;
+
+  SnapshotWriter writer;
+  std::vector< entt::entity > entities;
+  std::vector< entt::entity > component_entities;
+  std::vector< entt::entity > block;
+  std::size_t section = 0, offset = 0;
+  bool collected = false, done = false;
+
+  SnapshotSaver(std::ostream& out, const SnapshotFormat& format, std::size_t block_size = 4096)
+  : out(out), format(format), block_size(block_size)
+  {
+  }
+
+  void begin(entt::registry& r)
+  {
+    entities.clear();
+    r.each([&](auto entity){ entities.push_back(entity); });
+    writer.indices.clear();
+    for(std::size_t i = 0; i < entities.size(); ++i)
+      writer.indices[entities[i]] = (std::uint32_t)i;
+
+    out.write(reinterpret_cast< const char* >(&Snapshot::magic), sizeof(Snapshot::magic));
+    out.write(reinterpret_cast< const char* >(&Snapshot::version), sizeof(Snapshot::version));
+
+    section = offset = 0;
+    collected = done = false;
+  }
+
+  // Writes up to `budget` entities worth of sections, returns true when done
+  bool step(entt::registry& r, std::size_t budget)
+  {
+    std::size_t written = 0;
+    while(!done && written < budget)
+    {
+      // Section 0 is the entity list, then one per component type
+      if(section == 0)
+      {
+        std::size_t count = std::min(block_size, entities.size() - offset);
+        write_section(Snapshot::entity_section, count);
+        offset += count;
+        written += count;
+        if(offset >= entities.size())
+          next_section();
+        continue;
+      }
+
+      if(section > format.components.size())
+      {
+        write_section(Snapshot::end_section, 0);
+        out.flush();
+        done = true;
+        break;
+      }
+
+      const auto& component = format.components[section - 1];
+      if(!collected)
+      {
+        component.collect(r, component_entities);
+        // Skip entities that were not part of the snapshot
+        component_entities.erase(
+          std::remove_if(component_entities.begin(), component_entities.end(),
+            [&](auto entity){ return writer.indices.count(entity) == 0; }),
+          component_entities.end());
+        collected = true;
+      }
+
+      // The registry may have changed since the list was collected
+      std::size_t count = std::min(block_size, component_entities.size() - offset);
+      block.clear();
+      for(std::size_t i = offset; i < offset + count; ++i)
+        if(component.contains(r, component_entities[i]))
+          block.push_back(component_entities[i]);
+      if(! block.empty())
+      {
+        for(auto entity : block)
+          writer.write_entity(entity);
+        component.save(r, writer, block, 0, block.size());
+        write_section(component.id, block.size());
+      }
+      offset += count;
+      written += count;
+      if(offset >= component_entities.size())
+        next_section();
+    }
+    return done;
+  }
+
+  void next_section()
+  {
+    ++section;
+    offset = 0;
+    collected = false;
+  }
+
+  void write_section(std::uint32_t type, std::uint32_t count)
+  {
+    // Strings interned by this block must precede it
+    if(! writer.pending_strings.empty())
+    {
+      std::vector< char > block;
+      block.swap(writer.buffer);
+      for(const auto& str : writer.pending_strings)
+      {
+        writer.write((std::uint32_t)str.size());
+        writer.write_bytes(str.data(), str.size());
+      }
+      std::uint32_t string_count = writer.pending_strings.size();
+      writer.pending_strings.clear();
+      write_raw(Snapshot::string_section, string_count);
+      writer.buffer.swap(block);
+    }
+    write_raw(type, count);
+  }
+
+  void write_raw(std::uint32_t type, std::uint32_t count)
+  {
+    std::uint32_t header[3] = { type, count, (std::uint32_t)writer.buffer.size() };
+    out.write(reinterpret_cast< const char* >(header), sizeof(header));
+    out.write(writer.buffer.data(), writer.buffer.size());
+    writer.buffer.clear();
+  }
+};
+
+// Streams a snapshot into a registry a section at a time. Entities are
+// created in bulk before any component is loaded, so references between
+// entities resolve regardless of section order.
+struct SnapshotLoader
+{
+  std::istream& in;
+  const SnapshotFormat& format;
+
+  std::vector< entt::entity > entities;
+  std::vector< std::string > strings;
+  std::vector< char > buffer;
+  std::vector< entt::entity > section_entities;
+  bool started = false, done = false, failed = false;
+
+  SnapshotLoader(std::istream& in, const SnapshotFormat& format)
+  : in(in), format(format)
+  {
+  }
+
+  // Loads sections until `budget` entities have been processed, returns
+  // true once the whole snapshot is loaded or loading failed
+  bool step(entt::registry& r, std::size_t budget)
+  {
+    if(!started && !read_header())
+      return fail();
+    started = true;
+
+    std::size_t processed = 0;
+    while(!done && processed < budget)
+    {
+      std::uint32_t header[3];
+      if(!in.read(reinterpret_cast< char* >(header), sizeof(header)))
+        return fail();
+      const std::uint32_t type = header[0], count = header[1], size = header[2];
+
+      buffer.resize(size);
+      if(size > 0 && !in.read(buffer.data(), size))
+        return fail();
+      SnapshotReader reader{ buffer.data(), buffer.size(), 0, strings, entities };
+
+      if(type == Snapshot::end_section)
+      {
+        done = true;
+        break;
+      }
+      else if(type == Snapshot::string_section)
+      {
+        for(std::uint32_t i = 0; i < count; ++i)
+        {
+          std::uint32_t length;
+          if(!reader.read(length) || reader.offset + length > reader.size)
+            return fail();
+          strings.emplace_back(reader.data + reader.offset, length);
+          reader.offset += length;
+        }
+      }
+      else if(type == Snapshot::entity_section)
+      {
+        std::size_t first = entities.size();
+        entities.resize(first + count);
+        r.create(entities.begin() + first, entities.end());
+      }
+      else if(auto component = format.find(type))
+      {
+        section_entities.resize(count);
+        for(auto& entity : section_entities)
+          if(!reader.read_entity(entity) || entity == entt::null)
+            return fail();
+        if(!component->load(r, reader, section_entities))
+          return fail();
+      }
+      // Unknown component types are skipped
+
+      processed += count;
+    }
+    return done;
+  }
+
+  bool read_header()
+  {
+    std::uint32_t header[2];
+    if(!in.read(reinterpret_cast< char* >(header), sizeof(header)))
+      return false;
+    return header[0] == Snapshot::magic && header[1] == Snapshot::version;
+  }
+
+  bool fail()
+  {
+    failed = done = true;
+    return true;
+  }
+};
+
+// Registers the components defined by this library
+inline void add_ui_snapshot_components(SnapshotFormat& format)
+{
+  format.component< Controller >("UI::Controller",
+    [](entt::registry& r, SnapshotWriter& w, entt::entity entity)
+    {
+      const auto& c = r.get< Controller >(entity);
+      w.write_string(c.controller ? c.controller->name : std::string());
+    },
+    [](entt::registry& r, SnapshotReader& reader, entt::entity entity)
+    {
+      std::string name;
+      if(!reader.read_string(name))
+        return false;
+      if(! name.empty())
+        r.ctx< ControllerManager >().take_controller(name, r, entity);
+      return true;
+    }
+  );
+
+  format.component< Relationship >("UI::Relationship",
+    [](entt::registry& r, SnapshotWriter& w, entt::entity entity)
+    {
+      w.write_entity(r.get< Relationship >(entity).parent);
+    },
+    [](entt::registry& r, SnapshotReader& reader, entt::entity entity)
+    {
+      entt::entity parent;
+      if(!reader.read_entity(parent))
+        return false;
+      if(parent != entt::null)
+        attach(r, entity, parent);
+      else
+        r.get_or_emplace< Relationship >(entity);
+      return true;
+    }
+  );
+
+  format.component< LocalTransform >("UI::LocalTransform",
+    [](entt::registry& r, SnapshotWriter& w, entt::entity entity)
+    {
+      w.write(r.get< LocalTransform >(entity));
+    },
+    [](entt::registry& r, SnapshotReader& reader, entt::entity entity)
+    {
+      LocalTransform local;
+      if(!reader.read(local))
+        return false;
+      set_local_transform(r, entity, local.matrix);
+      return true;
+    }
+  );
+
+  format.component< Tilemap >("UI::Tilemap",
+    [](entt::registry& r, SnapshotWriter& w, entt::entity entity)
+    {
+      const auto& map = r.get< Tilemap >(entity);
+      w.write_string(map.tileset_path);
+      w.write(map.size);
+      w.write(map.tile_size);
+      w.write(map.chunk_size);
+      w.write(map.position);
+      w.write(map.sort_key);
+      w.write_bytes(map.tiles.data(), map.tiles.size() * sizeof(std::uint32_t));
+    },
+    [](entt::registry& r, SnapshotReader& reader, entt::entity entity)
+    {
+      std::string path;
+      sf::Vector2u size, tile_size;
+      unsigned chunk_size;
+      if(!reader.read_string(path) || !reader.read(size) || !reader.read(tile_size) || !reader.read(chunk_size))
+        return false;
+
+      // Reject sizes the rest of the section can't hold before allocating
+      const std::uint64_t tile_count = (std::uint64_t)size.x * size.y;
+      const std::size_t remaining = reader.size - reader.offset;
+      const std::size_t fixed = sizeof(sf::Vector2f) + sizeof(std::uint64_t);
+      if(chunk_size == 0 || remaining < fixed || tile_count > (remaining - fixed) / sizeof(std::uint32_t))
+        return false;
+
+      // Maps built from a raw texture have no path to reload it from
+      auto textures = r.try_ctx< TextureCache >();
+      auto memory = r.try_ctx< WorldMemory* >();
+      auto resource = memory && *memory ? (*memory)->resource() : std::pmr::get_default_resource();
+      auto& map = textures && ! path.empty()
+        ? r.emplace_or_replace< Tilemap >(entity, *textures, path, size, tile_size, chunk_size, resource)
+        : r.emplace_or_replace< Tilemap >(entity, nullptr, size, tile_size, chunk_size, resource);
+      map.tileset_path = path;
+      return reader.read(map.position)
+        && reader.read(map.sort_key)
+        && reader.read_bytes(map.tiles.data(), map.tiles.size() * sizeof(std::uint32_t));
+    }
+  );
+}
+
+} // ::UI
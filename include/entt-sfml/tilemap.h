@@ -0,0 +1,179 @@
+#pragma once
+
+#include "asset-cache.h"
+#include "render-queue.h"
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <vector>
+
+namespace UI
+{
+
+struct TilemapChunk
+{
+  sf::VertexArray vertices{ sf::Triangles };
+  bool dirty = true;
+};
+
+// A grid of tiles drawn from a single tileset texture. Tile ids index the
+// tileset left to right, top to bottom, starting at 1; 0 is an empty cell.
+// The map is split into chunk_size x chunk_size chunks whose vertices are
+// only rebuilt when one of their tiles changes.
+struct Tilemap
+{
+  static constexpr std::uint32_t empty_tile = 0;
+
+  const sf::Texture* tileset = nullptr;
+  std::string tileset_path;
+  sf::Vector2u size;
+  sf::Vector2u tile_size;
+  unsigned chunk_size = 32;
+  sf::Vector2f position;
+  std::uint64_t sort_key = 0;
+
+  std::pmr::vector< std::uint32_t > tiles;
+  std::pmr::vector< TilemapChunk > chunks;
+  sf::Vector2u chunk_count;
+
+  // A chunk_size of 0 is treated as 1
+  Tilemap(const sf::Texture* tileset, sf::Vector2u size, sf::Vector2u tile_size, unsigned chunk_size = 32, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : tileset(tileset), size(size), tile_size(tile_size), chunk_size(std::max(1u, chunk_size)),
+    tiles(size.x * size.y, empty_tile, resource), chunks(resource),
+    chunk_count((size.x + this->chunk_size - 1) / this->chunk_size, (size.y + this->chunk_size - 1) / this->chunk_size)
+  {
+    chunks.resize(chunk_count.x * chunk_count.y);
+  }
+
+  Tilemap(TextureCache& cache, const std::string& tileset_path, sf::Vector2u size, sf::Vector2u tile_size, unsigned chunk_size = 32, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : Tilemap(cache.get(tileset_path), size, tile_size, chunk_size, resource)
+  {
+    this->tileset_path = tileset_path;
+  }
+
+  std::uint32_t get_tile(unsigned x, unsigned y) const
+  {
+    if(x >= size.x || y >= size.y)
+      return empty_tile;
+    return tiles[y * size.x + x];
+  }
+
+  void set_tile(unsigned x, unsigned y, std::uint32_t tile)
+  {
+    if(x >= size.x || y >= size.y)
+      return;
+    auto& cell = tiles[y * size.x + x];
+    if(cell == tile)
+      return;
+    cell = tile;
+    chunk_at(x / chunk_size, y / chunk_size).dirty = true;
+  }
+
+  TilemapChunk& chunk_at(unsigned cx, unsigned cy)
+  {
+    return chunks[cy * chunk_count.x + cx];
+  }
+
+  void rebuild_chunk(unsigned cx, unsigned cy)
+  {
+    auto& chunk = chunk_at(cx, cy);
+    chunk.dirty = false;
+    chunk.vertices.clear();
+    if(!tileset || tile_size.x == 0 || tile_size.y == 0)
+      return;
+
+    const unsigned columns = tileset->getSize().x / tile_size.x;
+    if(columns == 0)
+      return;
+
+    const unsigned x_end = std::min(size.x, (cx + 1) * chunk_size);
+    const unsigned y_end = std::min(size.y, (cy + 1) * chunk_size);
+    const float tw = tile_size.x, th = tile_size.y;
+
+    for(unsigned y = cy * chunk_size; y < y_end; ++y)
+    {
+      for(unsigned x = cx * chunk_size; x < x_end; ++x)
+      {
+        std::uint32_t tile = tiles[y * size.x + x];
+        if(tile == empty_tile)
+          continue;
+        tile -= 1;
+
+        const float u = (tile % columns) * tw, v = (tile / columns) * th;
+        const float px = x * tw, py = y * th;
+
+        const sf::Vertex quad[4] = {
+          sf::Vertex({ px, py }, { u, v }),
+          sf::Vertex({ px + tw, py }, { u + tw, v }),
+          sf::Vertex({ px + tw, py + th }, { u + tw, v + th }),
+          sf::Vertex({ px, py + th }, { u, v + th })
+        };
+        chunk.vertices.append(quad[0]);
+        chunk.vertices.append(quad[1]);
+        chunk.vertices.append(quad[2]);
+        chunk.vertices.append(quad[0]);
+        chunk.vertices.append(quad[2]);
+        chunk.vertices.append(quad[3]);
+      }
+    }
+  }
+
+  // Submits every chunk overlapping `view`, rebuilding dirty ones first
+  void submit(RenderQueue& queue, const sf::View& view)
+  {
+    if(!tileset || chunks.empty())
+      return;
+
+    // Axis-aligned bounds of the (possibly rotated) view in map space
+    const sf::Transform& to_world = view.getInverseTransform();
+    const sf::Vector2f corners[4] = {
+      to_world.transformPoint(-1.f, -1.f),
+      to_world.transformPoint(1.f, -1.f),
+      to_world.transformPoint(1.f, 1.f),
+      to_world.transformPoint(-1.f, 1.f)
+    };
+    sf::Vector2f min = corners[0], max = corners[0];
+    for(const auto& corner : corners)
+    {
+      min.x = std::min(min.x, corner.x); min.y = std::min(min.y, corner.y);
+      max.x = std::max(max.x, corner.x); max.y = std::max(max.y, corner.y);
+    }
+    min -= position;
+    max -= position;
+
+    const float chunk_w = (float)chunk_size * tile_size.x;
+    const float chunk_h = (float)chunk_size * tile_size.y;
+    const int x0 = std::max(0, (int)std::floor(min.x / chunk_w));
+    const int y0 = std::max(0, (int)std::floor(min.y / chunk_h));
+    const int x1 = std::min((int)chunk_count.x - 1, (int)std::floor(max.x / chunk_w));
+    const int y1 = std::min((int)chunk_count.y - 1, (int)std::floor(max.y / chunk_h));
+
+    sf::RenderStates states;
+    states.texture = tileset;
+    states.transform.translate(position);
+
+    for(int cy = y0; cy <= y1; ++cy)
+    {
+      for(int cx = x0; cx <= x1; ++cx)
+      {
+        auto& chunk = chunk_at(cx, cy);
+        if(chunk.dirty)
+          rebuild_chunk(cx, cy);
+        if(chunk.vertices.getVertexCount() > 0)
+          queue.submit(sort_key, chunk.vertices, states);
+      }
+    }
+  }
+};
+
+inline void draw_tilemaps(entt::registry& registry, RenderQueue& queue, const sf::View& view)
+{
+  registry.view< Tilemap >().each(
+    [&](auto& tilemap)
+    {
+      tilemap.submit(queue, view);
+    }
+  );
+}
+
+} // ::UI
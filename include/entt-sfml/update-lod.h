@@ -0,0 +1,144 @@
+#pragma once
+
+#include "hierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace UI
+{
+
+  // Entities with this component are updated every `interval` frames
+  // (0 = dormant) and receive the time elapsed since their last update
+  struct UpdateRate
+  {
+    std::uint16_t interval = 1;
+    std::uint16_t phase = 0;
+    std::chrono::milliseconds last_update{ 0 };
+    std::chrono::milliseconds last_dt{ 0 };
+    // Frame of the last update, none yet
+    std::uint64_t last_frame = std::numeric_limits< std::uint64_t >::max();
+    // Set when a dormant entity is given an interval again
+    bool waking = false;
+  };
+
+  struct UpdateScheduler
+  {
+    struct Bucket
+    {
+      float max_distance;
+      std::uint16_t interval;
+    };
+
+    // Sorted by distance; anything further than the last bucket is dormant
+    std::vector< Bucket > buckets{ { 600.f, 1 }, { 1500.f, 4 }, { 4000.f, 16 } };
+
+    // Upper bound for the dt handed to an entity waking from dormancy
+    std::chrono::milliseconds max_dt{ 250 };
+
+    // 0 until the first begin_frame(); until then everything is due
+    std::uint64_t frame = 0;
+    std::chrono::milliseconds now{ 0 };
+
+    void begin_frame(std::chrono::milliseconds dt)
+    {
+      ++frame;
+      now += dt;
+    }
+
+    std::uint16_t interval_for(float distance) const
+    {
+      for(const auto& bucket : buckets)
+        if(distance <= bucket.max_distance)
+          return bucket.interval;
+      return 0;
+    }
+
+    void set_interval(UpdateRate& rate, entt::entity entity, std::uint16_t interval)
+    {
+      // Entities waking from dormancy keep their last_update, so their first
+      // dt covers the time they slept, capped by max_dt
+      if(rate.interval == interval)
+        return;
+      if(rate.interval == 0)
+        rate.waking = true;
+      rate.interval = interval;
+      // Spread entities sharing an interval over different frames
+      rate.phase = interval > 1 ? (std::uint16_t)(entt::to_integral(entity) % interval) : 0;
+    }
+
+    // Buckets every scheduled entity by `score(entity)`, a distance-like value
+    template< typename Score >
+    void assign(entt::registry& r, Score score)
+    {
+      r.view< UpdateRate >().each(
+        [&](auto entity, auto& rate)
+        {
+          set_interval(rate, entity, interval_for(score(entity)));
+        }
+      );
+    }
+
+    // Buckets scheduled entities with a WorldTransform by distance to `center`
+    void assign_by_distance(entt::registry& r, sf::Vector2f center)
+    {
+      r.view< UpdateRate, WorldTransform >().each(
+        [&](auto entity, auto& rate, auto& world)
+        {
+          sf::Vector2f d = world.position() - center;
+          set_interval(rate, entity, interval_for(std::sqrt(d.x * d.x + d.y * d.y)));
+        }
+      );
+    }
+
+    // True if `rate` is due this frame, replacing `dt` with the time since
+    // its last update
+    bool due(UpdateRate& rate, std::chrono::milliseconds& dt)
+    {
+      if(frame == 0)
+        return true;
+      if(rate.interval == 0)
+        return false;
+      if(rate.interval > 1 && (frame + rate.phase) % rate.interval != 0)
+        return false;
+      // Several systems may ask in the same frame, they all get the same dt
+      if(rate.last_frame == frame)
+      {
+        dt = rate.last_dt;
+        return true;
+      }
+      // Entities that have never been updated keep the frame's dt
+      if(rate.last_update.count() > 0)
+        dt = rate.waking ? std::min(now - rate.last_update, max_dt) : now - rate.last_update;
+      rate.waking = false;
+      rate.last_update = now;
+      rate.last_frame = frame;
+      rate.last_dt = dt;
+      return true;
+    }
+
+    // Entities without an UpdateRate are always due
+    bool due(entt::registry& r, entt::entity entity, std::chrono::milliseconds& dt)
+    {
+      auto rate = r.try_get< UpdateRate >(entity);
+      return !rate || due(*rate, dt);
+    }
+
+    // Calls fn(entity, dt, components...) for every due entity in the view
+    template< typename... Components, typename Func >
+    void each(entt::registry& r, std::chrono::milliseconds dt, Func fn)
+    {
+      r.view< Components... >().each(
+        [&](auto entity, auto&... components)
+        {
+          auto entity_dt = dt;
+          if(due(r, entity, entity_dt))
+            fn(entity, entity_dt, components...);
+        }
+      );
+    }
+  };
+
+}
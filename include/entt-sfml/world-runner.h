@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace UI
+{
+
+// Ticks many independent worlds (registries) across a pool of threads.
+// Worlds are handed out longest-running-first from a shared counter, so
+// expensive worlds start early and cheap ones fill the gaps. Worlds must not
+// share mutable state other than through thread-safe objects such as
+// SharedAssets.
+struct WorldRunner
+{
+  using Tick = std::function< void(std::chrono::milliseconds) >;
+  using WorldId = std::size_t;
+
+  struct World
+  {
+    WorldId id;
+    Tick tick;
+    std::chrono::microseconds budget;
+    std::chrono::microseconds last_cost{ 0 };
+    std::size_t overruns = 0;
+    // Set when the last tick threw
+    std::exception_ptr error;
+    std::size_t failures = 0;
+  };
+
+  std::vector< std::unique_ptr< World > > worlds;
+  WorldId next_id = 0;
+
+  // Called from worker threads when a world's tick exceeds its budget
+  std::function< void(const World&) > on_overrun;
+  // Called from worker threads when a world's tick throws; the world keeps
+  // being ticked on later frames
+  std::function< void(const World&) > on_error;
+
+  std::vector< std::thread > threads;
+  std::mutex mutex;
+  std::condition_variable work_ready, work_done;
+  std::vector< World* > order;
+  std::atomic< std::size_t > next{ 0 };
+  std::size_t busy = 0;
+  std::uint64_t generation = 0;
+  std::chrono::milliseconds dt{ 0 };
+  bool stopping = false;
+
+  // The calling thread also runs worlds, so it makes threads - 1 workers
+  WorldRunner(unsigned thread_count = std::thread::hardware_concurrency())
+  {
+    for(unsigned i = 1; i < std::max(1u, thread_count); ++i)
+      threads.emplace_back([this]{ worker(); });
+  }
+
+  ~WorldRunner()
+  {
+    {
+      std::lock_guard< std::mutex > lock(mutex);
+      stopping = true;
+    }
+    work_ready.notify_all();
+    for(auto& thread : threads)
+      thread.join();
+  }
+
+  // Only call between ticks
+  WorldId add(Tick tick, std::chrono::microseconds budget = std::chrono::milliseconds(16))
+  {
+    auto world = std::make_unique< World >();
+    world->id = next_id++;
+    world->tick = std::move(tick);
+    world->budget = budget;
+    worlds.push_back(std::move(world));
+    return worlds.back()->id;
+  }
+
+  // A registry using RegistryMixin, ticked through RegistryMixin::ui_tick;
+  // use add() to run game systems as well
+  template< typename Registry >
+  WorldId add_registry(Registry& registry, std::chrono::microseconds budget = std::chrono::milliseconds(16))
+  {
+    return add([&registry](std::chrono::milliseconds dt){ registry.ui_tick(dt); }, budget);
+  }
+
+  // Only call between ticks
+  void remove(WorldId id)
+  {
+    worlds.erase(
+      std::remove_if(worlds.begin(), worlds.end(),
+        [id](const auto& world){ return world->id == id; }),
+      worlds.end());
+  }
+
+  // Ticks every world once and returns when all are done
+  void tick(std::chrono::milliseconds frame_dt)
+  {
+    order.clear();
+    for(auto& world : worlds)
+      order.push_back(world.get());
+    std::sort(order.begin(), order.end(),
+      [](const World* a, const World* b){ return a->last_cost > b->last_cost; });
+
+    {
+      std::lock_guard< std::mutex > lock(mutex);
+      dt = frame_dt;
+      next = 0;
+      busy = threads.size();
+      ++generation;
+    }
+    work_ready.notify_all();
+
+    run_worlds();
+
+    std::unique_lock< std::mutex > lock(mutex);
+    work_done.wait(lock, [this]{ return busy == 0; });
+  }
+
+  void run_worlds()
+  {
+    using clock = std::chrono::steady_clock;
+    for(std::size_t i = next++; i < order.size(); i = next++)
+    {
+      World& world = *order[i];
+      const auto started = clock::now();
+      world.error = nullptr;
+      try
+      {
+        world.tick(dt);
+      }
+      catch(...)
+      {
+        world.error = std::current_exception();
+        ++world.failures;
+        if(on_error)
+          on_error(world);
+      }
+      world.last_cost = std::chrono::duration_cast< std::chrono::microseconds >(clock::now() - started);
+      if(world.last_cost > world.budget)
+      {
+        ++world.overruns;
+        if(on_overrun)
+          on_overrun(world);
+      }
+    }
+  }
+
+  void worker()
+  {
+    std::uint64_t seen = 0;
+    while(true)
+    {
+      {
+        std::unique_lock< std::mutex > lock(mutex);
+        work_ready.wait(lock, [&]{ return stopping || generation != seen; });
+        if(stopping)
+          return;
+        seen = generation;
+      }
+
+      run_worlds();
+
+      {
+        std::lock_guard< std::mutex > lock(mutex);
+        --busy;
+      }
+      work_done.notify_one();
+    }
+  }
+};
+
+}
@@ -0,0 +1,111 @@
+// Animates and batches sprites without a window, and times batching a
+// crowd. Build with
+//   ruby build.rb --entt=PATH --cfiles=animation-test.cc --output=animation-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+UI::AnimationTable make_table(bool loop)
+{
+  return UI::AnimationTable(nullptr, { { 0, 0, 16, 16 }, { 16, 0, 16, 16 }, { 32, 0, 16, 16 } }, 0.1f, loop);
+}
+
+void test_frames()
+{
+  entt::registry r;
+  auto looping = make_table(true), once = make_table(false);
+  auto a = r.create(), b = r.create();
+  r.emplace< UI::SpriteAnimation >(a).play(&looping);
+  r.emplace< UI::SpriteAnimation >(b).play(&once);
+
+  UI::animate_sprites(r, 50ms);
+  CHECK(r.get< UI::SpriteAnimation >(a).frame == 0);
+  UI::animate_sprites(r, 60ms);
+  CHECK(r.get< UI::SpriteAnimation >(a).frame == 1);
+
+  // 0.11s + 0.25s = 3 frames: wraps to 0, stops on the last one
+  UI::animate_sprites(r, 250ms);
+  CHECK(r.get< UI::SpriteAnimation >(a).frame == 0);
+  CHECK(r.get< UI::SpriteAnimation >(b).frame == 2);
+  CHECK(! r.get< UI::SpriteAnimation >(b).playing);
+}
+
+void test_batches()
+{
+  entt::registry r;
+  auto table = make_table(true);
+  UI::RenderQueue queue;
+  UI::SpriteBatcher batcher;
+
+  auto add = [&](sf::Vector2f position, std::uint8_t layer)
+  {
+    auto entity = r.create();
+    r.emplace< UI::SpriteAnimation >(entity).play(&table);
+    UI::AnimatedSprite sprite;
+    sprite.position = position;
+    sprite.layer = layer;
+    r.emplace< UI::AnimatedSprite >(entity, sprite);
+    return entity;
+  };
+  add({ 0, 0 }, 0);
+  add({ 20, 0 }, 0);
+  auto moved = add({ 10, 0 }, 1);
+  sf::Transform world;
+  world.translate(100, 50);
+  r.emplace< UI::WorldTransform >(moved, UI::WorldTransform{ world });
+
+  batcher.submit(r, queue);
+  // One vertex command per texture, layer and depth
+  CHECK(queue.size() == 2);
+  CHECK(queue.vertices.size() == 3 * 6);
+
+  // `position` is local to the WorldTransform
+  bool found = false;
+  for(const auto& command : queue.commands)
+    if(UI::SortKey::layer(command.key) == 1)
+    {
+      const auto& corner = queue.vertices[command.first_vertex].position;
+      found = corner.x == 110 && corner.y == 50;
+    }
+  CHECK(found);
+}
+
+void time_crowd()
+{
+  entt::registry r;
+  auto table = make_table(true);
+  UI::RenderQueue queue;
+  UI::SpriteBatcher batcher;
+
+  for(int i = 0; i < 20000; ++i)
+  {
+    auto entity = r.create();
+    r.emplace< UI::SpriteAnimation >(entity).play(&table);
+    UI::AnimatedSprite sprite;
+    sprite.position = sf::Vector2f(i % 200 * 4, i / 200 * 4);
+    r.emplace< UI::AnimatedSprite >(entity, sprite);
+  }
+
+  using clock = std::chrono::steady_clock;
+  const int frames = 100;
+  const auto started = clock::now();
+  for(int frame = 0; frame < frames; ++frame)
+  {
+    UI::animate_sprites(r, 16ms);
+    batcher.submit(r, queue);
+    CHECK(queue.size() == 1);
+    queue.clear();
+  }
+  const auto elapsed = std::chrono::duration_cast< std::chrono::microseconds >(clock::now() - started);
+  std::cout << "20000 sprites: " << elapsed.count() / frames << "us per frame (animate + batch)" << std::endl;
+}
+
+int main()
+{
+  test_frames();
+  test_batches();
+  time_crowd();
+  return report();
+}
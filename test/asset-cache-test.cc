@@ -0,0 +1,114 @@
+// Shared asset cache: one load per path across threads, failures and
+// exceptions, and per-world caches borrowing from it. Build with
+//   ruby build.rb --entt=PATH --cfiles=asset-cache-test.cc --output=asset-cache-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+// Loads the path's length after a delay, so concurrent requests overlap
+struct CountingLoader
+{
+  std::atomic< int > loads{ 0 };
+
+  std::unique_ptr< int > load(const std::string& path)
+  {
+    ++loads;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if(path == "missing")
+      return nullptr;
+    if(path == "throws")
+      throw std::runtime_error("corrupt asset");
+    return std::make_unique< int >(path.size());
+  }
+};
+
+struct SharedCounting : UI::SharedAssetCache< int, SharedCounting >, CountingLoader
+{
+};
+
+struct LocalCounting : UI::AssetCache< int, LocalCounting >, CountingLoader
+{
+};
+
+template< typename Func >
+void on_threads(int count, Func fn)
+{
+  std::vector< std::thread > threads;
+  for(int i = 0; i < count; ++i)
+    threads.emplace_back(fn, i);
+  for(auto& thread : threads)
+    thread.join();
+}
+
+void test_dedup()
+{
+  SharedCounting cache;
+  std::vector< int* > got(8);
+  on_threads(8, [&](int i){ got[i] = cache.get(i % 2 ? "odd" : "even.png"); });
+
+  CHECK(cache.loads == 2);
+  CHECK(cache.size() == 2);
+  for(int i = 0; i < 8; ++i)
+    CHECK(got[i] == got[i % 2] && got[i] != nullptr);
+  CHECK(*got[1] == 3);
+}
+
+void test_failures()
+{
+  SharedCounting cache;
+  CHECK(cache.get("missing") == nullptr);
+  CHECK(cache.get("missing") == nullptr);
+  CHECK(cache.loads == 2);
+  CHECK(cache.size() == 0);
+
+  // Every thread waiting on a load that throws sees the exception, and the
+  // path is tried again afterwards
+  std::atomic< int > thrown{ 0 };
+  on_threads(4,
+    [&](int)
+    {
+      try
+      {
+        cache.get("throws");
+      }
+      catch(const std::runtime_error&)
+      {
+        ++thrown;
+      }
+    });
+  CHECK(thrown == 4);
+  CHECK(cache.size() == 0);
+  const int loads = cache.loads;
+  try
+  {
+    cache.get("throws");
+  }
+  catch(const std::runtime_error&)
+  {
+  }
+  CHECK(cache.loads == loads + 1);
+}
+
+void test_borrowed()
+{
+  SharedCounting shared;
+  LocalCounting local;
+  local.shared = &shared;
+
+  auto record = local.get_asset("tiles.png");
+  CHECK(record && record->get() == shared.get("tiles.png"));
+  CHECK(! record->asset);
+  CHECK(local.get("tiles.png") == record->get());
+  CHECK(local.loads == 0);
+  CHECK(shared.loads == 1);
+}
+
+int main()
+{
+  test_dedup();
+  test_failures();
+  test_borrowed();
+  return report();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Minimal checks for the headless test programs. Each program includes this
+// once, runs its checks and returns report() from main().
+#include <iostream>
+
+inline int& check_failures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(cond) \
+  do { \
+    if(!(cond)) \
+    { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+      ++check_failures(); \
+    } \
+  } while(0)
+
+inline int report()
+{
+  if(check_failures())
+    std::cerr << check_failures() << " checks failed" << std::endl;
+  else
+    std::cout << "all checks passed" << std::endl;
+  return check_failures() ? 1 : 0;
+}
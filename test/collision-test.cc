@@ -0,0 +1,142 @@
+// Contact begin/end sequencing and the sort-and-sweep broadphase. Build with
+//   ruby build.rb --entt=PATH --cfiles=collision-test.cc --output=collision-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <random>
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+  int begins = 0, ends = 0;
+
+  TestRegistry()
+  {
+    ui_init_headless();
+    auto& dispatcher = ctx< entt::dispatcher >();
+    dispatcher.sink< UI::ContactBeginEvent >().connect< &TestRegistry::on_begin >(this);
+    dispatcher.sink< UI::ContactEndEvent >().connect< &TestRegistry::on_end >(this);
+  }
+
+  void on_begin(const UI::ContactBeginEvent&) { ++begins; }
+  void on_end(const UI::ContactEndEvent&) { ++ends; }
+
+  void place(entt::entity entity, float x, float y)
+  {
+    sf::Transform matrix;
+    matrix.translate(x, y);
+    emplace_or_replace< UI::WorldTransform >(entity, UI::WorldTransform{ matrix });
+  }
+
+  entt::entity circle(float x, float y, float radius)
+  {
+    auto entity = create();
+    place(entity, x, y);
+    UI::Collider collider;
+    collider.radius = radius;
+    emplace< UI::Collider >(entity, collider);
+    return entity;
+  }
+
+  void step()
+  {
+    ui_collision_world().update(*this);
+    ctx< entt::dispatcher >().update();
+  }
+};
+
+void test_sequence()
+{
+  TestRegistry r;
+  auto a = r.circle(0, 0, 10);
+  auto b = r.circle(15, 0, 10);
+
+  r.step();
+  CHECK(r.begins == 1 && r.ends == 0);
+  // Still touching: no new events
+  r.step();
+  CHECK(r.begins == 1 && r.ends == 0);
+
+  r.place(b, 50, 0);
+  r.step();
+  CHECK(r.begins == 1 && r.ends == 1);
+
+  r.place(b, 5, 5);
+  r.step();
+  CHECK(r.begins == 2 && r.ends == 1);
+
+  // Destroying one side ends the contact
+  r.destroy(a);
+  r.step();
+  CHECK(r.begins == 2 && r.ends == 2);
+  CHECK(r.ui_collision_world().proxies.size() == 1);
+}
+
+void test_filters()
+{
+  TestRegistry r;
+  auto a = r.circle(0, 0, 10);
+  auto b = r.circle(5, 0, 10);
+  r.get< UI::Collider >(a).layer = r.get< UI::Collider >(a).mask = 2;
+  r.get< UI::Collider >(b).layer = r.get< UI::Collider >(b).mask = 4;
+  r.step();
+  CHECK(r.begins == 0);
+
+  // A collider with no position yet is left out, not put at the origin
+  auto unplaced = r.create();
+  UI::Collider collider;
+  collider.radius = 10;
+  r.emplace< UI::Collider >(unplaced, collider);
+  r.step();
+  CHECK(r.begins == 0);
+
+  r.place(unplaced, 3, 0);
+  r.step();
+  CHECK(r.begins == 2);
+}
+
+void test_broadphase_matches_brute_force()
+{
+  TestRegistry r;
+  std::mt19937 random(7);
+  std::uniform_real_distribution< float > coord(0, 500), radius(2, 12);
+  std::vector< entt::entity > entities;
+  for(int i = 0; i < 300; ++i)
+    entities.push_back(r.circle(coord(random), coord(random), radius(random)));
+
+  for(int frame = 0; frame < 3; ++frame)
+  {
+    // Later frames move everything, so both the merge of new proxies and
+    // the insertion sort are exercised
+    if(frame > 0)
+      for(auto entity : entities)
+        r.place(entity, coord(random), coord(random));
+    r.step();
+
+    std::size_t expected = 0;
+    for(std::size_t i = 0; i < entities.size(); ++i)
+      for(std::size_t j = i + 1; j < entities.size(); ++j)
+      {
+        const auto pa = r.get< UI::WorldTransform >(entities[i]).position();
+        const auto pb = r.get< UI::WorldTransform >(entities[j]).position();
+        const float reach = r.get< UI::Collider >(entities[i]).radius + r.get< UI::Collider >(entities[j]).radius;
+        const sf::Vector2f d = pb - pa;
+        expected += d.x * d.x + d.y * d.y < reach * reach;
+      }
+    CHECK(r.ui_collision_world().contacts.size() == expected);
+
+    bool sorted = true;
+    const auto& proxies = r.ui_collision_world().proxies;
+    for(std::size_t i = 1; i < proxies.size(); ++i)
+      sorted = sorted && !(proxies[i].min_x < proxies[i - 1].min_x);
+    CHECK(sorted);
+  }
+}
+
+int main()
+{
+  test_sequence();
+  test_filters();
+  test_broadphase_matches_brute_force();
+  return report();
+}
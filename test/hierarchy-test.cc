@@ -0,0 +1,111 @@
+// World transforms after reparenting and destroying entities. Build with
+//   ruby build.rb --entt=PATH --cfiles=hierarchy-test.cc --output=hierarchy-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+
+  TestRegistry()
+  {
+    ui_init_headless();
+  }
+
+  entt::entity make(float x, float y)
+  {
+    auto entity = create();
+    sf::Transform local;
+    local.translate(x, y);
+    UI::set_local_transform(*this, entity, local);
+    return entity;
+  }
+
+  sf::Vector2f position(entt::entity entity)
+  {
+    return get< UI::WorldTransform >(entity).position();
+  }
+
+};
+
+void test_propagation()
+{
+  TestRegistry r;
+  auto parent = r.make(10, 0), child = r.make(5, 0), grandchild = r.make(1, 0);
+  CHECK(UI::attach(r, child, parent));
+  CHECK(UI::attach(r, grandchild, child));
+  r.ui_update_transforms();
+  CHECK(r.position(grandchild) == sf::Vector2f(16, 0));
+  CHECK(r.empty< UI::TransformDirty >());
+
+  // Moving the parent moves the whole subtree
+  sf::Transform moved;
+  moved.translate(20, 0);
+  UI::set_local_transform(r, parent, moved);
+  r.ui_update_transforms();
+  CHECK(r.position(child) == sf::Vector2f(25, 0));
+  CHECK(r.position(grandchild) == sf::Vector2f(26, 0));
+
+  // No cycles
+  CHECK(! UI::attach(r, parent, grandchild));
+  CHECK(! UI::attach(r, parent, parent));
+}
+
+void test_reparent()
+{
+  TestRegistry r;
+  auto a = r.make(10, 0), b = r.make(0, 100), child = r.make(5, 0), grandchild = r.make(1, 0);
+  UI::attach(r, child, a);
+  UI::attach(r, grandchild, child);
+  r.ui_update_transforms();
+
+  CHECK(UI::attach(r, child, b));
+  r.ui_update_transforms();
+  CHECK(r.get< UI::Relationship >(a).children == 0);
+  CHECK(r.get< UI::Relationship >(b).children == 1);
+  CHECK(r.position(child) == sf::Vector2f(5, 100));
+  CHECK(r.position(grandchild) == sf::Vector2f(6, 100));
+
+  UI::detach(r, child);
+  r.ui_update_transforms();
+  CHECK(r.position(grandchild) == sf::Vector2f(6, 0));
+}
+
+void test_destroy()
+{
+  TestRegistry r;
+  auto parent = r.make(10, 0);
+  entt::entity children[3];
+  for(int i = 0; i < 3; ++i)
+  {
+    children[i] = r.make(i, 0);
+    UI::attach(r, children[i], parent);
+  }
+  r.ui_update_transforms();
+
+  // Destroying a middle child keeps the sibling list intact
+  r.destroy(children[1]);
+  CHECK(r.get< UI::Relationship >(parent).children == 2);
+  std::size_t linked = 0;
+  for(auto child = r.get< UI::Relationship >(parent).first_child; child != entt::null;
+    child = r.get< UI::Relationship >(child).next_sibling)
+    ++linked;
+  CHECK(linked == 2);
+
+  // Destroying the parent leaves its children as roots in place
+  r.destroy(parent);
+  r.ui_update_transforms();
+  CHECK(r.get< UI::Relationship >(children[0]).parent == entt::null);
+  CHECK(r.position(children[0]) == sf::Vector2f(0, 0));
+  CHECK(r.position(children[2]) == sf::Vector2f(2, 0));
+  CHECK(r.empty< UI::TransformDirty >());
+}
+
+int main()
+{
+  test_propagation();
+  test_reparent();
+  test_destroy();
+  return report();
+}
@@ -0,0 +1,111 @@
+// Per-world memory caps and the memory report. Build with
+//   ruby build.rb --entt=PATH --cfiles=memory-test.cc --output=memory-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+};
+
+// Owning its WorldMemory is wrong: it would be destroyed before the
+// containers built on it
+struct OwningRegistry
+: entt::registry,
+  UI::RegistryMixin< OwningRegistry >
+{
+  UI::WorldMemory memory;
+};
+
+bool has_entry(const UI::MemoryReport& report, const std::string& name)
+{
+  for(const auto& entry : report.entries)
+    if(entry.name == name)
+      return true;
+  return false;
+}
+
+void test_accounting()
+{
+  UI::AccountingResource accounting(1024);
+  void* p = accounting.allocate(1000);
+  CHECK(accounting.used == 1000);
+  bool refused = false;
+  try
+  {
+    accounting.deallocate(accounting.allocate(100), 100);
+  }
+  catch(const std::bad_alloc&)
+  {
+    refused = true;
+  }
+  CHECK(refused);
+  CHECK(accounting.used == 1000);
+  accounting.deallocate(p, 1000);
+  CHECK(accounting.used == 0);
+  CHECK(accounting.peak == 1000);
+}
+
+void test_world_cap()
+{
+  const std::size_t limit = 256 * 1024;
+  UI::WorldMemory memory(limit);
+  TestRegistry r;
+  r.ui_init_headless(&memory);
+  CHECK(r.ui_memory_resource() == memory.resource());
+
+  // The render queue's buffers count against the world until it is full
+  bool refused = false;
+  try
+  {
+    for(int i = 0; i < 100000; ++i)
+      r.ui_render_queue().submit_vertices(UI::SortKey::make(0, 0), 600, nullptr);
+  }
+  catch(const std::bad_alloc&)
+  {
+    refused = true;
+  }
+  CHECK(refused);
+  CHECK(memory.accounting.peak <= limit);
+  CHECK(memory.accounting.used > 0);
+
+  r.ui_render_queue().clear();
+  auto report = r.ui_memory_report();
+  CHECK(has_entry(report, "WorldMemory (allocated)"));
+  CHECK(! has_entry(report, "SharedTextureCache (video memory)"));
+}
+
+void test_member_rejected()
+{
+  OwningRegistry r;
+  bool rejected = false;
+  try
+  {
+    r.ui_init_headless(&r.memory);
+  }
+  catch(const std::invalid_argument&)
+  {
+    rejected = true;
+  }
+  CHECK(rejected);
+}
+
+void test_shared_report()
+{
+  UI::SharedAssets shared;
+  TestRegistry r;
+  r.ui_init_headless(nullptr, &shared);
+  auto report = r.ui_memory_report();
+  CHECK(has_entry(report, "SharedTextureCache (video memory)"));
+  CHECK(has_entry(report, "SharedFontCache"));
+}
+
+int main()
+{
+  test_accounting();
+  test_world_cap();
+  test_member_rejected();
+  test_shared_report();
+  return report();
+}
@@ -0,0 +1,75 @@
+// Sorts and merges render commands without a window. Build with
+//   ruby build.rb --entt=PATH --cfiles=render-queue-test.cc --output=render-queue-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <algorithm>
+#include <random>
+
+using UI::SortKey;
+
+void test_order()
+{
+  UI::RenderQueue queue;
+  const std::uint64_t keys[] = {
+    SortKey::make(2, 0), SortKey::make(1, 5), SortKey::make(1, 0), SortKey::make(1, 5), SortKey::make(0, 65535)
+  };
+  for(auto key : keys)
+    queue.submit_vertices(key, 6, nullptr);
+  queue.sort();
+
+  // Ascending, and commands with equal keys keep their submission order
+  const std::uint32_t expected[] = { 4, 2, 1, 3, 0 };
+  for(std::size_t i = 0; i < queue.order.size(); ++i)
+    CHECK(queue.order[i].index == expected[i]);
+}
+
+void test_matches_stable_sort()
+{
+  UI::RenderQueue queue;
+  std::mt19937_64 random(42);
+  std::vector< std::pair< std::uint64_t, std::uint32_t > > expected;
+  for(std::uint32_t i = 0; i < 5000; ++i)
+  {
+    // Few distinct layers and depths, so many keys tie
+    const std::uint64_t key = SortKey::make(random() % 4, random() % 16, random() % 2, random() % 3);
+    queue.submit_vertices(key, 3, nullptr);
+    expected.push_back({ key, i });
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+    [](const auto& a, const auto& b){ return a.first < b.first; });
+  queue.sort();
+
+  bool same = queue.order.size() == expected.size();
+  for(std::size_t i = 0; same && i < expected.size(); ++i)
+    same = queue.order[i].key == expected[i].first && queue.order[i].index == expected[i].second;
+  CHECK(same);
+}
+
+void test_merge()
+{
+  UI::RenderQueue queue;
+  sf::RectangleShape shape(sf::Vector2f(4, 4));
+
+  queue.submit_vertices(SortKey::make(0, 0), 6, nullptr);
+  queue.submit_vertices(SortKey::make(0, 1), 6, nullptr);
+  queue.submit_vertices(SortKey::make(1, 0), 6, nullptr);
+  // A drawable ends the run
+  queue.submit(SortKey::make(1, 1), shape);
+  queue.submit_vertices(SortKey::make(1, 2), 6, nullptr);
+  // So does a different blend mode
+  queue.submit_vertices(SortKey::make(1, 3), 6, nullptr, sf::BlendAdd);
+  queue.submit_vertices(SortKey::make(1, 4), 6, nullptr, sf::BlendAdd);
+  queue.sort();
+
+  CHECK(queue.batch_end(0) == 3);
+  CHECK(queue.batch_end(4) == 5);
+  CHECK(queue.batch_end(5) == 7);
+}
+
+int main()
+{
+  test_order();
+  test_matches_stable_sort();
+  test_merge();
+  return report();
+}
@@ -0,0 +1,164 @@
+// Replicates a registry over a socket pair. Build with
+//   ruby build.rb --entt=PATH --cfiles=replication-test.cc --output=replication-test
+#include "entt-sfml/entt-sfml.h"
+#include "entt-sfml/replication.h"
+#include "check.h"
+#include <set>
+
+struct Velocity
+{
+  float x,y;
+};
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+
+  TestRegistry()
+  {
+    ui_init_headless();
+  }
+
+};
+
+std::set< std::pair< float, float > > velocities(entt::registry& r)
+{
+  std::set< std::pair< float, float > > values;
+  r.view< Velocity >().each(
+    [&](auto entity, auto& velocity)
+    {
+      values.insert({ velocity.x, velocity.y });
+    }
+  );
+  return values;
+}
+
+void sync(UI::ReplicationServer& server, entt::registry& source, UI::ReplicationClient& client, entt::registry& mirror)
+{
+  server.update(source);
+  CHECK(client.update(mirror));
+  // Read the acks back
+  server.update(source);
+}
+
+void test_replication()
+{
+  TestRegistry source, mirror;
+  auto sockets = UI::LocalSocket::pair();
+  CHECK(sockets.first.is_open() && sockets.second.is_open());
+
+  UI::ReplicationServer server;
+  server.socket = std::move(sockets.first);
+  server.replicator.replicate< Velocity >(source);
+
+  UI::ReplicationClient client;
+  client.socket = std::move(sockets.second);
+  client.mirror.replicate< Velocity >();
+
+  std::vector< entt::entity > entities(50);
+  source.create(entities.begin(), entities.end());
+  for(std::size_t i = 0; i < entities.size(); ++i)
+    source.emplace< Velocity >(entities[i], Velocity{ (float)i, 0.f });
+  sync(server, source, client, mirror);
+  CHECK(mirror.size< Velocity >() == 50);
+  CHECK(velocities(mirror) == velocities(source));
+
+  for(std::size_t i = 0; i < entities.size(); i += 2)
+    source.replace< Velocity >(entities[i], Velocity{ (float)i, 1.5f });
+  source.destroy(entities[1]);
+  source.remove< Velocity >(entities[3]);
+  sync(server, source, client, mirror);
+  CHECK(mirror.size< Velocity >() == 48);
+  CHECK(velocities(mirror) == velocities(source));
+
+  // A stalled observer must not make pending changes grow without bound
+  server.replicator.window = 0;
+  for(int frame = 0; frame < 100; ++frame)
+  {
+    for(std::size_t i = 4; i < entities.size(); ++i)
+      source.replace< Velocity >(entities[i], Velocity{ (float)frame, (float)i });
+    server.update(source);
+  }
+  CHECK(server.replicator.dirty.size() == entities.size() - 4);
+
+  server.replicator.window = 16;
+  sync(server, source, client, mirror);
+  CHECK(velocities(mirror) == velocities(source));
+}
+
+void test_reconnect()
+{
+  TestRegistry source, mirror;
+  auto sockets = UI::LocalSocket::pair();
+
+  UI::ReplicationServer server;
+  server.socket = std::move(sockets.first);
+  server.replicator.replicate< Velocity >(source);
+
+  UI::ReplicationClient client;
+  client.socket = std::move(sockets.second);
+  client.mirror.replicate< Velocity >();
+
+  std::vector< entt::entity > entities(20);
+  source.create(entities.begin(), entities.end());
+  for(std::size_t i = 0; i < entities.size(); ++i)
+    source.emplace< Velocity >(entities[i], Velocity{ (float)i, 0.f });
+  sync(server, source, client, mirror);
+  CHECK(server.connected);
+
+  // The observer goes away; nothing changes on the server side meanwhile,
+  // so only the reset can bring a new observer up to date
+  client.socket.close();
+  server.update(source);
+  server.update(source);
+  CHECK(! server.connected);
+  CHECK(! server.socket.is_open());
+
+  TestRegistry fresh;
+  auto again = UI::LocalSocket::pair();
+  server.socket = std::move(again.first);
+  UI::ReplicationClient observer;
+  observer.socket = std::move(again.second);
+  observer.mirror.replicate< Velocity >();
+
+  sync(server, source, observer, fresh);
+  CHECK(fresh.size< Velocity >() == entities.size());
+  CHECK(velocities(fresh) == velocities(source));
+}
+
+void test_max_pending()
+{
+  TestRegistry source;
+  auto sockets = UI::LocalSocket::pair();
+
+  UI::ReplicationServer server;
+  server.socket = std::move(sockets.first);
+  server.replicator.replicate< Velocity >(source);
+  server.replicator.window = 1000000;
+  server.max_pending = 4096;
+
+  std::vector< entt::entity > entities(1000);
+  source.create(entities.begin(), entities.end());
+  for(auto entity : entities)
+    source.emplace< Velocity >(entity, Velocity{ 1.f, 2.f });
+
+  // The peer never reads: update() must not block, and once the socket is
+  // full packets wait in the outbox only up to max_pending
+  for(int frame = 0; frame < 500; ++frame)
+  {
+    for(auto entity : entities)
+      source.replace< Velocity >(entity, Velocity{ (float)frame, 2.f });
+    server.update(source);
+  }
+  CHECK(server.socket.is_open());
+  CHECK(server.socket.pending() < server.max_pending + 2 * server.writer.bytes.size());
+}
+
+int main()
+{
+  test_replication();
+  test_reconnect();
+  test_max_pending();
+  return report();
+}
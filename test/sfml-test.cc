@@ -134,13 +134,12 @@ int main()
       {
         shape.shape->setPosition(transform.x, transform.y);
         shape.shape->setRotation(transform.radians * 180 / M_PI);
-        registry.ctx< entt::dispatcher >()
-          .enqueue(UI::RenderDrawableEvent{ shape.shape.get() });
+        registry.ui_render_queue().submit(UI::SortKey::make(0, 0), *shape.shape);
       }
     );
 
     window.clear(sf::Color::Black);
-    registry.ctx< entt::dispatcher >().update< UI::RenderDrawableEvent >();
+    registry.ui_render();
     window.display();
   }
   
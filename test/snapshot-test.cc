@@ -0,0 +1,167 @@
+// Saves a registry to a snapshot over several steps and loads it back.
+// Build with
+//   ruby build.rb --entt=PATH --cfiles=snapshot-test.cc --output=snapshot-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <set>
+#include <sstream>
+
+struct Velocity
+{
+  float x,y;
+};
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+
+  TestRegistry()
+  {
+    ui_init_headless();
+    ui_snapshot_format().component< Velocity >("Velocity");
+  }
+
+};
+
+std::set< std::pair< float, float > > velocities(entt::registry& r)
+{
+  std::set< std::pair< float, float > > values;
+  r.view< Velocity >().each(
+    [&](auto entity, auto& velocity)
+    {
+      values.insert({ velocity.x, velocity.y });
+    }
+  );
+  return values;
+}
+
+void save(TestRegistry& r, std::ostream& out)
+{
+  UI::SnapshotSaver saver(out, r.ui_snapshot_format(), 16);
+  saver.begin(r);
+  while(! saver.step(r, 16))
+    ;
+}
+
+bool load(TestRegistry& r, std::istream& in)
+{
+  UI::SnapshotLoader loader(in, r.ui_snapshot_format());
+  while(! loader.step(r, 16))
+    ;
+  return ! loader.failed;
+}
+
+void test_components_and_hierarchy()
+{
+  TestRegistry source;
+  std::vector< entt::entity > entities(100);
+  source.create(entities.begin(), entities.end());
+  for(std::size_t i = 0; i < entities.size(); ++i)
+    source.emplace< Velocity >(entities[i], Velocity{ (float)i, (float)i * 2 });
+  for(std::size_t i = 1; i < 10; ++i)
+    UI::attach(source, entities[i], entities[0]);
+
+  std::stringstream stream;
+  save(source, stream);
+
+  TestRegistry loaded;
+  CHECK(load(loaded, stream));
+  CHECK(loaded.size< Velocity >() == 100);
+  CHECK(velocities(loaded) == velocities(source));
+
+  std::size_t parents = 0, children = 0;
+  loaded.view< UI::Relationship >().each(
+    [&](auto entity, auto& rel)
+    {
+      if(rel.children)
+      {
+        ++parents;
+        children += rel.children;
+      }
+    }
+  );
+  CHECK(parents == 1);
+  CHECK(children == 9);
+}
+
+void test_destroyed_between_steps()
+{
+  TestRegistry source;
+  std::vector< entt::entity > entities(100);
+  source.create(entities.begin(), entities.end());
+  for(std::size_t i = 0; i < entities.size(); ++i)
+    source.emplace< Velocity >(entities[i], Velocity{ (float)i, 0.f });
+
+  std::stringstream stream;
+  UI::SnapshotSaver saver(stream, source.ui_snapshot_format(), 16);
+  saver.begin(source);
+  // Stop part way through the Velocity section, the last one registered
+  const std::size_t velocity_section = source.ui_snapshot_format().components.size();
+  while(saver.section != velocity_section || saver.offset == 0)
+    saver.step(source, 16);
+  CHECK(saver.offset + 2 < saver.component_entities.size());
+
+  // Saving is spread over frames, the registry may change in between. Pick
+  // entities the saver has collected but not written yet.
+  source.destroy(saver.component_entities.back());
+  source.remove< Velocity >(saver.component_entities[saver.offset]);
+  while(! saver.step(source, 16))
+    ;
+
+  TestRegistry loaded;
+  CHECK(load(loaded, stream));
+  CHECK(loaded.size< Velocity >() == 98);
+  CHECK(velocities(loaded) == velocities(source));
+}
+
+void test_tilemap_without_path()
+{
+  TestRegistry source;
+  auto entity = source.create();
+  auto& map = source.emplace< UI::Tilemap >(entity, nullptr, sf::Vector2u(40, 3), sf::Vector2u(16, 16), 0);
+  CHECK(map.chunk_size == 1);
+  map.set_tile(39, 2, 7);
+
+  std::stringstream stream;
+  save(source, stream);
+
+  TestRegistry loaded;
+  CHECK(load(loaded, stream));
+  CHECK(loaded.size< UI::Tilemap >() == 1);
+  CHECK(loaded.ui_texture_cache().cache.empty());
+  loaded.view< UI::Tilemap >().each(
+    [&](auto& loaded_map)
+    {
+      CHECK(loaded_map.tileset == nullptr);
+      CHECK(loaded_map.get_tile(39, 2) == 7);
+      CHECK(loaded_map.get_tile(0, 0) == UI::Tilemap::empty_tile);
+    }
+  );
+}
+
+void test_truncated()
+{
+  TestRegistry source;
+  std::vector< entt::entity > entities(10);
+  source.create(entities.begin(), entities.end());
+  for(auto entity : entities)
+    source.emplace< Velocity >(entity, Velocity{ 1.f, 2.f });
+
+  std::stringstream stream;
+  save(source, stream);
+  std::string bytes = stream.str();
+  std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+
+  TestRegistry loaded;
+  CHECK(! load(loaded, truncated));
+}
+
+int main()
+{
+  test_components_and_hierarchy();
+  test_destroyed_between_steps();
+  test_tilemap_without_path();
+  test_truncated();
+  return report();
+}
@@ -0,0 +1,89 @@
+// Chunk bookkeeping and culling of a tilemap without a window. The tileset
+// is an empty texture, so chunks are rebuilt (and their dirty flag cleared)
+// without producing vertices. Build with
+//   ruby build.rb --entt=PATH --cfiles=tilemap-test.cc --output=tilemap-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+
+std::size_t count_dirty(const UI::Tilemap& map)
+{
+  std::size_t dirty = 0;
+  for(const auto& chunk : map.chunks)
+    dirty += chunk.dirty;
+  return dirty;
+}
+
+void test_chunks()
+{
+  sf::Texture tileset;
+  UI::Tilemap map(&tileset, sf::Vector2u(100, 50), sf::Vector2u(16, 16), 32);
+  CHECK(map.chunk_count == sf::Vector2u(4, 2));
+  CHECK(map.chunks.size() == 8);
+  CHECK(count_dirty(map) == 8);
+
+  UI::Tilemap single(&tileset, sf::Vector2u(3, 3), sf::Vector2u(16, 16), 0);
+  CHECK(single.chunk_size == 1);
+  CHECK(single.chunk_count == sf::Vector2u(3, 3));
+}
+
+void test_dirty()
+{
+  sf::Texture tileset;
+  UI::Tilemap map(&tileset, sf::Vector2u(100, 50), sf::Vector2u(16, 16), 32);
+  for(unsigned cy = 0; cy < map.chunk_count.y; ++cy)
+    for(unsigned cx = 0; cx < map.chunk_count.x; ++cx)
+      map.rebuild_chunk(cx, cy);
+  CHECK(count_dirty(map) == 0);
+
+  // Only the chunk holding the tile, and only if the tile changes
+  map.set_tile(70, 40, 3);
+  CHECK(count_dirty(map) == 1);
+  CHECK(map.chunk_at(2, 1).dirty);
+  map.rebuild_chunk(2, 1);
+  map.set_tile(70, 40, 3);
+  CHECK(count_dirty(map) == 0);
+
+  // Out of bounds writes are ignored
+  map.set_tile(100, 0, 1);
+  map.set_tile(0, 50, 1);
+  CHECK(count_dirty(map) == 0);
+}
+
+void test_culling()
+{
+  sf::Texture tileset;
+  UI::RenderQueue queue;
+  UI::Tilemap map(&tileset, sf::Vector2u(100, 50), sf::Vector2u(16, 16), 32);
+
+  // Chunks are 512x512 pixels: this view only overlaps chunk (0, 0)
+  map.submit(queue, sf::View(sf::FloatRect(0, 0, 400, 300)));
+  CHECK(count_dirty(map) == 7);
+  CHECK(! map.chunk_at(0, 0).dirty);
+
+  // 800..1200 x 450..750 overlaps chunks (1..2, 0..1)
+  map.submit(queue, sf::View(sf::Vector2f(1000, 600), sf::Vector2f(400, 300)));
+  CHECK(count_dirty(map) == 3);
+  CHECK(! map.chunk_at(1, 1).dirty && ! map.chunk_at(2, 0).dirty);
+
+  // A view entirely off the map touches nothing
+  UI::Tilemap other(&tileset, sf::Vector2u(100, 50), sf::Vector2u(16, 16), 32);
+  other.submit(queue, sf::View(sf::Vector2f(-5000, -5000), sf::Vector2f(400, 300)));
+  CHECK(count_dirty(other) == 8);
+
+  // The map's position moves it under the view
+  other.position = sf::Vector2f(-512, 0);
+  other.submit(queue, sf::View(sf::FloatRect(0, 0, 400, 300)));
+  CHECK(count_dirty(other) == 7);
+  CHECK(! other.chunk_at(1, 0).dirty);
+
+  // Empty chunks submit nothing
+  CHECK(queue.size() == 0);
+}
+
+int main()
+{
+  test_chunks();
+  test_dirty();
+  test_culling();
+  return report();
+}
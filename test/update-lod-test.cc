@@ -0,0 +1,115 @@
+// Update rate buckets, due frames and the dt handed to scheduled entities.
+// Build with
+//   ruby build.rb --entt=PATH --cfiles=update-lod-test.cc --output=update-lod-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+
+using namespace std::chrono_literals;
+
+void test_buckets()
+{
+  UI::UpdateScheduler scheduler;
+  CHECK(scheduler.interval_for(0) == 1);
+  CHECK(scheduler.interval_for(600) == 1);
+  CHECK(scheduler.interval_for(601) == 4);
+  CHECK(scheduler.interval_for(2000) == 16);
+  CHECK(scheduler.interval_for(5000) == 0);
+
+  entt::registry r;
+  auto near = r.create(), middle = r.create(), far = r.create();
+  auto place = [&](entt::entity entity, float x)
+  {
+    sf::Transform matrix;
+    matrix.translate(x, 0);
+    r.emplace< UI::WorldTransform >(entity, UI::WorldTransform{ matrix });
+    r.emplace< UI::UpdateRate >(entity);
+  };
+  place(near, 100);
+  place(middle, 1100);
+  place(far, 10100);
+  scheduler.assign_by_distance(r, sf::Vector2f(100, 0));
+  CHECK(r.get< UI::UpdateRate >(near).interval == 1);
+  CHECK(r.get< UI::UpdateRate >(middle).interval == 4);
+  CHECK(r.get< UI::UpdateRate >(far).interval == 0);
+}
+
+void test_due()
+{
+  entt::registry r;
+  UI::UpdateScheduler scheduler;
+  auto entity = r.create();
+  auto& rate = r.emplace< UI::UpdateRate >(entity);
+  scheduler.set_interval(rate, entity, 4);
+
+  std::size_t updates = 0;
+  std::chrono::milliseconds last{ 0 };
+  for(int frame = 0; frame < 12; ++frame)
+  {
+    scheduler.begin_frame(16ms);
+    auto dt = 16ms;
+    if(scheduler.due(rate, dt))
+    {
+      ++updates;
+      last = dt;
+
+      // A second system asking in the same frame gets the same dt
+      auto again = 16ms;
+      CHECK(scheduler.due(rate, again) && again == dt);
+    }
+  }
+  CHECK(updates == 3);
+  CHECK(last == 64ms);
+}
+
+void test_waking()
+{
+  entt::registry r;
+  UI::UpdateScheduler scheduler;
+  auto sleeper = r.create(), slow = r.create();
+  r.emplace< UI::UpdateRate >(sleeper);
+  r.emplace< UI::UpdateRate >(slow);
+  auto& sleeping = r.get< UI::UpdateRate >(sleeper);
+  auto& slow_rate = r.get< UI::UpdateRate >(slow);
+  scheduler.set_interval(slow_rate, slow, 32);
+
+  auto step = [&](UI::UpdateRate& rate)
+  {
+    auto dt = 16ms;
+    return scheduler.due(rate, dt) ? dt : -1ms;
+  };
+
+  scheduler.begin_frame(16ms);
+  step(sleeping);
+  scheduler.set_interval(sleeping, sleeper, 0);
+  for(int frame = 0; frame < 100; ++frame)
+  {
+    scheduler.begin_frame(16ms);
+    CHECK(step(sleeping) == -1ms);
+  }
+
+  // Waking is capped by max_dt, once
+  scheduler.set_interval(sleeping, sleeper, 1);
+  scheduler.begin_frame(16ms);
+  CHECK(step(sleeping) == scheduler.max_dt);
+  scheduler.begin_frame(16ms);
+  CHECK(step(sleeping) == 16ms);
+
+  // A long but regular interval is not capped
+  std::chrono::milliseconds dt{ 0 };
+  for(int frame = 0; frame < 64; ++frame)
+  {
+    scheduler.begin_frame(16ms);
+    auto got = step(slow_rate);
+    if(got != -1ms)
+      dt = got;
+  }
+  CHECK(dt == 32 * 16ms);
+}
+
+int main()
+{
+  test_buckets();
+  test_due();
+  test_waking();
+  return report();
+}
@@ -0,0 +1,117 @@
+// Ticking many worlds across threads: ordering, exceptions and overruns.
+// Build with
+//   ruby build.rb --entt=PATH --cfiles=world-runner-test.cc --output=world-runner-test
+#include "entt-sfml/entt-sfml.h"
+#include "check.h"
+#include <atomic>
+#include <stdexcept>
+
+using namespace std::chrono_literals;
+
+struct TestRegistry
+: entt::registry,
+  UI::RegistryMixin< TestRegistry >
+{
+
+  TestRegistry()
+  {
+    ui_init_headless();
+  }
+
+};
+
+void test_longest_first()
+{
+  // Only the calling thread, so worlds run one after another
+  UI::WorldRunner runner(1);
+  std::vector< int > ran;
+  for(int ms : { 1, 6, 3 })
+    runner.add(
+      [&ran, ms](std::chrono::milliseconds)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        ran.push_back(ms);
+      });
+
+  runner.tick(16ms);
+  ran.clear();
+  runner.tick(16ms);
+  CHECK(ran == std::vector< int >({ 6, 3, 1 }));
+}
+
+void test_every_world_once()
+{
+  UI::WorldRunner runner(4);
+  std::vector< std::atomic< int > > ticks(50);
+  std::atomic< long > total_dt{ 0 };
+  for(auto& count : ticks)
+    runner.add(
+      [&count, &total_dt](std::chrono::milliseconds dt)
+      {
+        ++count;
+        total_dt += dt.count();
+      });
+
+  for(int frame = 0; frame < 20; ++frame)
+    runner.tick(10ms);
+  bool all = true;
+  for(auto& count : ticks)
+    all = all && count == 20;
+  CHECK(all);
+  CHECK(total_dt == 50 * 20 * 10);
+}
+
+void test_errors_and_overruns()
+{
+  UI::WorldRunner runner(2);
+  std::atomic< int > errors{ 0 }, overruns{ 0 }, healthy{ 0 };
+  runner.on_error = [&](const UI::WorldRunner::World&){ ++errors; };
+  runner.on_overrun = [&](const UI::WorldRunner::World&){ ++overruns; };
+
+  bool fail = true;
+  auto failing = runner.add([&](std::chrono::milliseconds){ if(fail) throw std::runtime_error("tick failed"); });
+  runner.add([&](std::chrono::milliseconds){ ++healthy; });
+  runner.add([](std::chrono::milliseconds){ std::this_thread::sleep_for(5ms); }, 1ms);
+
+  runner.tick(16ms);
+  CHECK(errors == 1);
+  CHECK(healthy == 1);
+  CHECK(overruns == 1);
+
+  const UI::WorldRunner::World* world = nullptr;
+  for(auto& w : runner.worlds)
+    if(w->id == failing)
+      world = w.get();
+  CHECK(world && world->error && world->failures == 1);
+
+  // A throwing world keeps being ticked, and its error clears once it stops
+  fail = false;
+  runner.tick(16ms);
+  CHECK(errors == 1);
+  CHECK(healthy == 2);
+  CHECK(world && ! world->error && world->failures == 1);
+}
+
+void test_registries()
+{
+  UI::WorldRunner runner(2);
+  std::vector< std::unique_ptr< TestRegistry > > registries;
+  for(int i = 0; i < 4; ++i)
+  {
+    registries.push_back(std::make_unique< TestRegistry >());
+    runner.add_registry(*registries.back());
+  }
+  for(int frame = 0; frame < 3; ++frame)
+    runner.tick(16ms);
+  for(auto& r : registries)
+    CHECK(r->ui_update_scheduler().frame == 3);
+}
+
+int main()
+{
+  test_longest_first();
+  test_every_world_once();
+  test_errors_and_overruns();
+  test_registries();
+  return report();
+}